@@ -1,32 +1,144 @@
 #include <ctype.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+/// Directories can be listed (see diff_directory), files told apart from devices (see close_written) and compiled
+/// programs cached (see compile_cached)
+#define POSIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) && defined(__linux__)
+/// Programs are compiled to native code when they are continued (see jit_compile)
+#define JIT
+#include <elf.h>
+#endif
 
 #define TAG "bfdb"
 #define COMMAND_SZ 32
 
-#define PROGRAM_SIZE 4096
 #define STACK_SIZE 512
 #define DATA_SIZE 65535
 
+/// The count of instructions an IR buffer has room for before it grows for the first time
+#define IR_CAPACITY 256
+
+/// The highest optimization level
+#define MAX_OPT_LEVEL 3
+/// The optimization level used if none is given
+#define DEFAULT_OPT_LEVEL 2
+
+/// The maximum count of instructions executed ahead of time during compilation
+#define PREFIX_STEPS 10000000
+
+/// The count of cells whose values the constant tracking remembers at once
+#define CONST_CELLS 64
+
+/// The maximum count of instructions a loop may take after it has been unrolled
+#define UNROLL_LIMIT 64
+
+/// The maximum count of cells a loop may access to be evaluated in closed form
+#define CLOSED_CELLS 16
+
+/// The count of instructions searched back for the store an addition can be folded into
+#define STORE_WINDOW 32
+
+/// The maximum count of instructions a program may execute in the differential test
+#define DIFF_STEPS 100000000
+
+/// The count of brainfuck instructions shown of a source span before it is shortened
+#define SPAN_PREVIEW 24
+
+/// The maximum count of breakpoints
+#define BREAKPOINT_COUNT 32
+
+/// The count of iterations after which a loop that is continued is compiled to native code (see jit_run)
+#define JIT_THRESHOLD 10000
+
+/// The count of bytes a standalone executable buffers before writing its output (see emit_elf)
+#define ELF_BUFFER 4096
+
+/// The directory in the user's cache directory compiled programs are stored in (see compile_cached)
+#define CACHE_DIR "bfdb"
+/// The version of the cache files' format, cache files of other versions are compiled again
+#define CACHE_VERSION 4
+/// The start of the 64 bit FNV-1a hashes the cache uses (see cache_hash)
+#define CACHE_HASH_START 0xCBF29CE484222325
+
+/// The index of the engine programs are run with unless another one is chosen (see engines), the native one where
+/// it is available
+#ifdef JIT
+#define DEFAULT_ENGINE 2
+#else
+#define DEFAULT_ENGINE 1
+#endif
+
 // Intermediate representation
 
 /// Brainfuck's instructions as well as EOF to signal the end of the program
-const char* INSTRUCTIONS[] = { "EOF", ">", "<", "+", "-", ".", ",", "[", "]" };
+const char* INSTRUCTIONS[] = { "EOF", ">", "<", "+", "-", ".", ",", "[", "]", "[-]", "[->+<]", "[>]", ">[", ">]", "[?]", "[>[->+<]<-]", "[-]+" };
+
+enum {
+    OP_END, OP_INC, OP_DEC, OP_ADD, OP_SUB, OP_OUT, OP_IN, OP_JMP, OP_RET, OP_CLEAR, OP_MULADD, OP_SCAN,
+    OP_MOVE_JMP, OP_MOVE_RET, OP_GUARD, OP_MULMUL, OP_SET
+};
 
+/// The flags an instruction can carry
 enum {
-    OP_END, OP_INC, OP_DEC, OP_ADD, OP_SUB, OP_OUT, OP_IN, OP_JMP, OP_RET
+    /// The instruction is part of a loop whose guard checks the cells it accesses (see hoist_bounds_checks)
+    IF_UNCHECKED = 1,
+
+    /// A breakpoint stops the execution before the instruction (see dbg_apply_breakpoints)
+    IF_BREAK = 2
 };
 
-/// An instruction containing an operator and an operand
+/// An instruction containing an operator, its flags, an operand and the offset of the cell it targets relative to the
+/// data pointer, OP_MULMUL also reads the cell at the source offset
 typedef struct instruction_t {
     unsigned short operator;
-    unsigned short operand;
+    unsigned short flags;
+    unsigned int operand;
+    int offset;
+    int source;
 } instruction_t;
 
+/// A pair of instructions that is fused into a single superinstruction
+typedef struct fusion_t {
+    /// The operator of the first instruction
+    unsigned short first;
+
+    /// The operator of the second instruction, whose operand the superinstruction keeps
+    unsigned short second;
+
+    /// The operator of the superinstruction
+    unsigned short fused;
+} fusion_t;
+
+/// The pairs that are fused, arithmetic already carries the pointer movement around it as its offset (see fold_offsets),
+/// so what remains is the movement that is emitted in front of the loop instructions
+const fusion_t FUSIONS[] = {
+    { .first = OP_INC, .second = OP_JMP, .fused = OP_MOVE_JMP },
+    { .first = OP_DEC, .second = OP_JMP, .fused = OP_MOVE_JMP },
+    { .first = OP_INC, .second = OP_RET, .fused = OP_MOVE_RET },
+    { .first = OP_DEC, .second = OP_RET, .fused = OP_MOVE_RET }
+};
+
+/// The count of fused pairs
+const int fusion_count = sizeof(FUSIONS) / sizeof(fusion_t);
+
 // Helper functions
 
 /// Splits a string by delimiters and returns a c-string array and the count of strings splitted
@@ -44,24 +156,141 @@ char **split(const char *const str, const char *const at, int *count);
 /// @return Whether or not the conversion succeeded
 bool to_int(const char *const str, int base, bool allow_neg, int *converted);
 
+/// Searches the tape for the first zero cell, starting at index and moving by stride
+/// @param data The tape to search
+/// @param index The index of the first cell to check
+/// @param stride The distance between the checked cells
+/// @return The index of the zero cell or -1 if the data pointer would leave the tape before reaching one
+long scan_tape(const unsigned short *data, long index, int stride);
+
 /// Checks if the index is in the tape's range
 /// @param index The index to check
 /// @return Whether or not the given index is valid
 bool dataptr_in_range(int index);
 
+/// Closes a file that was written to, removing what was written of it if that failed
+/// @param fp The file to close
+/// @param file_name The name of the file
+/// @return Whether or not the file was written completely
+bool close_written(FILE *fp, const char *const file_name);
+
 // Compilation
 
+/// The part of the source an instruction was compiled from
+typedef struct span_t {
+    /// The line of the span's first brainfuck instruction
+    int line;
+
+    /// The column of the span's first brainfuck instruction
+    int col;
+
+    /// The index of the span's first brainfuck instruction in the source
+    unsigned int start;
+
+    /// The index after the span's last brainfuck instruction in the source
+    unsigned int end;
+} span_t;
+
+/// A growable buffer of instructions, the form passes read and write the program in
+typedef struct ir_t {
+    /// The instructions
+    instruction_t *instructions;
+
+    /// The source span of each instruction
+    span_t *spans;
+
+    /// The count of instructions
+    unsigned int count;
+
+    /// The count of instructions the buffer has room for
+    unsigned int capacity;
+} ir_t;
+
+/// An instruction decoded for the threaded engine, which jumps straight to the code of its operator (see runtime_run)
+typedef struct threaded_t {
+    /// The address of the code that executes the instruction
+    const void *label;
+
+    /// The operand of the instruction
+    unsigned int operand;
+
+    /// The offset of the cell the instruction targets
+    int offset;
+
+    /// The offset of the cell OP_MULMUL reads besides the loop's cell
+    int source;
+
+    /// The flags of the instruction
+    unsigned short flags;
+
+    /// The count of iterations of the loop that ends with the instruction
+    unsigned int heat;
+} threaded_t;
+
+/// The native code of a program (see jit_compile)
+typedef struct jit_t {
+    /// The executable code, its entry point takes the runtime and the address of the instruction to start at
+    unsigned char *code;
+
+    /// The size of the code in bytes
+    size_t size;
+
+    /// The offset of each instruction's code
+    size_t *offsets;
+
+    /// Whether or not the code checks that the data pointer stays on the tape
+    bool checked;
+} jit_t;
+
+/// The outcomes of the data pointer analysis (see analyze_bounds)
+enum {
+    BOUNDS_UNANALYZED, BOUNDS_PROVEN, BOUNDS_DRIFT, BOUNDS_SCAN, BOUNDS_OFF_TAPE
+};
+
 /// A brainfuck program
 typedef struct program_t {
     /// The instructions of the brainfuck program
-    instruction_t instructions[PROGRAM_SIZE];
+    ir_t ir;
 
-    /// The count of instructions
-    unsigned short instr_count;
+    /// The instructions decoded for the threaded engine, NULL until the engine first runs the program
+    threaded_t *threaded;
+
+    /// The native code of the program, NULL until the program is first continued
+    jit_t *jit;
+
+    /// The brainfuck instructions of the source, without comments
+    char *code;
+
+    /// The count of brainfuck instructions in the source
+    unsigned int code_len;
+
+    /// The tape the program starts with (see evaluate_prefix)
+    unsigned short init_data[DATA_SIZE];
+
+    /// The data pointer the program starts with
+    unsigned int init_ptr;
+
+    /// The program counter the program starts with
+    unsigned int init_pc;
+
+    /// The count of instructions that were executed ahead of time
+    unsigned long prefix_steps;
+
+    /// The outcome of the data pointer analysis
+    int bounds;
+
+    /// The instruction that kept the analysis from proving the data pointer stays on the tape
+    unsigned int bounds_pc;
+
+    /// The lowest cell the program accesses, or the off-tape cell that made the analysis fail
+    long bounds_low;
+
+    /// The highest cell the program accesses
+    long bounds_high;
 } program_t;
 
 /// The program currently associated with bfdb
-program_t program = { .instr_count = 0 };
+program_t program = { .ir = { .count = 0 }, .threaded = NULL, .jit = NULL };
 
 /// Compiles the brainfuck program in fp to the intermediate representation
 /// @param fp The file to read
@@ -69,12 +298,340 @@ program_t program = { .instr_count = 0 };
 /// @return Whether or not the compilation succeeded
 bool compile(FILE *fp, program_t *prog);
 
+/// Compiles a brainfuck program that was read into memory to the intermediate representation
+/// @param source The source of the program
+/// @param size The size of the source in bytes
+/// @param prog The program structure to write the program to
+/// @return Whether or not the compilation succeeded
+bool compile_source(const char *source, size_t size, program_t *prog);
+
+/// Reads the rest of a file into memory
+/// @param fp The file to read
+/// @param size Set to the count of bytes read
+/// @return The bytes read, which have to be freed
+char *read_source(FILE *fp, size_t *size);
+
+/// Frees the instructions, the decoded and native code and the source of a program and leaves it empty
+/// @param prog The program to free
+void program_free(program_t *prog);
+
 /// Prints a formatted error as well as line and column information to stderr
 /// @param line The line the error occured in
 /// @param col The column in the line
 /// @param fmt The format
 void compile_error(int line, int col, const char *fmt, ...);
 
+/// Merges two source spans into the span that covers both
+/// @param a The first span
+/// @param b The second span
+/// @return The merged span
+span_t span_merge(span_t a, span_t b);
+
+/// Finds the instruction that was compiled from the brainfuck instruction at the given index
+/// @param prog The program to search
+/// @param index The index of the brainfuck instruction in the source, starting at 1
+/// @return The first instruction whose span ends after the brainfuck instruction
+unsigned int program_find(const program_t *prog, unsigned int index);
+
+/// Prints the brainfuck instructions of a source span, long spans are shortened
+/// @param fp The file to print to
+/// @param prog The program the span belongs to
+/// @param span The span to print
+void print_span(FILE *fp, const program_t *prog, span_t span);
+
+/// Prints the cell at the given offset from the data pointer
+/// @param fp The file to print to
+/// @param offset The offset of the cell
+void print_cell(FILE *fp, int offset);
+
+/// Prints what an instruction does in a readable form
+/// @param fp The file to print to
+/// @param instruction The instruction to print
+void print_instruction(FILE *fp, instruction_t instruction);
+
+/// Appends an instruction to an IR buffer, growing the buffer if it is full
+/// @param ir The buffer to append to
+/// @param instruction The instruction to append
+/// @param span The source span of the instruction
+void ir_emit(ir_t *ir, instruction_t instruction, span_t span);
+
+/// Frees the memory of an IR buffer and leaves it empty
+/// @param ir The buffer to free
+void ir_free(ir_t *ir);
+
+/// Runs the passes of the current optimization level over a program, relinking and verifying its jumps after each one
+/// @param prog The program to optimize
+/// @return Whether or not every pass left the program with valid jumps
+bool run_passes(program_t *prog);
+
+/// Removes loops that can never be entered and additions that undo each other, e.g. '+-'. Movements such as '<>' are
+/// kept, as the data pointer can leave the tape in between
+/// @param prog The program to clean up
+/// @param out The buffer to write the rewritten instructions to
+void remove_dead_code(const program_t *prog, ir_t *out);
+
+/// Folds runs of the same pointer or arithmetic instruction into a single instruction whose operand is the count
+/// @param prog The program to fold
+/// @param out The buffer to write the rewritten instructions to
+void fold_runs(const program_t *prog, ir_t *out);
+
+/// Replaces loops that only count the current cell down (or up) to zero, e.g. '[-]', by a single OP_CLEAR
+/// @param prog The program to fold
+/// @param out The buffer to write the rewritten instructions to
+void fold_clear_loops(const program_t *prog, ir_t *out);
+
+/// Replaces loops that decrement the current cell by one and add multiples of it to other cells, e.g. '[->++>+<<]',
+/// by one OP_MULADD per target cell followed by an OP_CLEAR
+/// @param prog The program to fold
+/// @param out The buffer to write the rewritten instructions to
+void fold_muladd_loops(const program_t *prog, ir_t *out);
+
+/// Replaces loops that only move the data pointer, e.g. '[>]' or '[<<]', by a single OP_SCAN whose offset is the stride
+/// @param prog The program to fold
+/// @param out The buffer to write the rewritten instructions to
+void fold_scan_loops(const program_t *prog, ir_t *out);
+
+/// Removes the pointer movement between loops by giving the arithmetic and I/O instructions the offset of their cell,
+/// the accumulated movement is emitted once before each loop instruction and where it turns back from a cell that no
+/// instruction checked
+/// @param prog The program to fold
+/// @param out The buffer to write the rewritten instructions to
+void fold_offsets(const program_t *prog, ir_t *out);
+
+/// A cell the constant tracking remembers
+typedef struct known_cell_t {
+    /// The index of the cell relative to the data pointer at the start of the tracking
+    long cell;
+
+    /// Whether or not the value of the cell is known
+    bool known;
+
+    /// The value of the cell
+    unsigned short value;
+} known_cell_t;
+
+/// What the constant tracking knows about the tape at an instruction
+typedef struct constants_t {
+    /// The cells that have been written to
+    known_cell_t cells[CONST_CELLS];
+
+    /// The count of remembered cells
+    int count;
+
+    /// Whether or not the cells that have not been written to are still zero, as they are at the start of the program
+    bool fresh;
+
+    /// The data pointer relative to the data pointer at the start of the tracking
+    long base;
+} constants_t;
+
+/// Looks up the value of a cell
+/// @param constants What is known about the tape
+/// @param cell The cell to look up
+/// @param value The value of the cell
+/// @return Whether or not the value of the cell is known
+bool constant_get(const constants_t *constants, long cell, unsigned short *value);
+
+/// Remembers the value of a cell or that it is unknown
+/// @param constants What is known about the tape
+/// @param cell The cell that was written to
+/// @param known Whether or not the new value is known
+/// @param value The new value
+void constant_set(constants_t *constants, long cell, bool known, unsigned short value);
+
+/// Forgets the values of all cells
+/// @param constants What is known about the tape
+void constant_forget(constants_t *constants);
+
+/// Emits a loop-free instruction, folding it with what is known about the tape, and tracks its effect
+/// @param constants What is known about the tape
+/// @param instruction The instruction to emit
+/// @param span The source span of the instruction
+/// @param out The buffer to write the instruction to
+void constant_emit(constants_t *constants, instruction_t instruction, span_t span, ir_t *out);
+
+/// The value of a cell after an iteration of a loop as a sum of multiples of the values its cells had before
+typedef struct affine_t {
+    /// The constant part of the value
+    unsigned short constant;
+
+    /// The factor of each cell's value, in the order the loop accesses them
+    unsigned short factors[CLOSED_CELLS];
+} affine_t;
+
+/// Looks up the index of a cell among the cells a loop accesses, adding it if the loop has not accessed it before
+/// @param cells The cells the loop accessed so far
+/// @param values The values of those cells
+/// @param count The count of those cells
+/// @param cell The cell to look up
+/// @return The index of the cell or -1 if the loop accesses too many cells
+int closed_form_cell(long *cells, affine_t *values, int *count, long cell);
+
+/// Emits a loop that runs once and adds the result of all iterations of the given loop to its cells at once, if the
+/// loop's cell is counted down by one and every other cell is either unchanged, set to a constant or gets a sum of
+/// multiples of the unchanged cells added in each iteration
+/// @param constants What is known about the tape
+/// @param ir The instructions of the program
+/// @param pc The index of the loop's OP_JMP
+/// @param out The buffer to write the instructions to
+/// @return Whether or not the loop could be evaluated in closed form
+bool constant_closed_form(constants_t *constants, const ir_t *ir, unsigned int pc, ir_t *out);
+
+/// Tracks the values of the cells that are known at compile time, replaces OP_MULADD by an OP_ADD when its loop's
+/// cell is known, unrolls loops whose trip count follows from the known value of their cell and evaluates loops that
+/// count their cell down and only add multiples of other cells, e.g. '[>[->+>+<<]>>[-<<+>>]<<<-]', in closed form
+/// @param prog The program to fold
+/// @param out The buffer to write the rewritten instructions to
+void fold_constants(const program_t *prog, ir_t *out);
+
+/// Folds additions and subtractions into the OP_CLEAR or OP_SET of their cell before them, e.g. '[-]+++++', so that
+/// the cell is set to the resulting constant by a single OP_SET
+/// @param prog The program to fold
+/// @param out The buffer to write the rewritten instructions to
+void fold_stores(const program_t *prog, ir_t *out);
+
+/// Fuses the pairs of instructions listed in FUSIONS into superinstructions, the offset of a superinstruction is the
+/// pointer movement of its first instruction
+/// @param prog The program to fuse
+/// @param out The buffer to write the rewritten instructions to
+void fuse_instructions(const program_t *prog, ir_t *out);
+
+/// Puts an OP_GUARD in front of each loop that returns to its cell after every iteration without entering another loop,
+/// so that its body can access the cells without checking them one by one
+/// @param prog The program to guard
+/// @param out The buffer to write the rewritten instructions to
+void hoist_bounds_checks(const program_t *prog, ir_t *out);
+
+/// Tracks the range of the data pointer through the whole program to prove that it never leaves the tape, in which case
+/// the program runs without any bounds checks
+/// @param prog The program to analyze
+void analyze_bounds(program_t *prog);
+
+/// Recomputes the operands of the jump instructions after a program has been rewritten
+/// @param ir The instructions whose jumps should be linked
+void link_jumps(ir_t *ir);
+
+/// Checks that every operator exists, that every loop instruction is paired with the one it jumps to and that the
+/// program ends with OP_END
+/// @param ir The instructions to check
+/// @return The index of the first invalid instruction or -1 if the instructions are valid
+long verify_ir(const ir_t *ir);
+
+// Program cache
+
+/// The start of a cache file, which is followed by the instructions, their spans, the non-zero cells of the initial tape
+/// and the source's brainfuck instructions. The data pointer analysis is not stored, a program without bounds checks is
+/// only as safe as the analysis that is run again on the instructions that were read, and so are its guards (see
+/// cache_check_guards)
+typedef struct cache_header_t {
+    /// The format of the file (see CACHE_VERSION)
+    unsigned int version;
+
+    /// The size of an instruction, which changes with bfdb's build
+    unsigned int instruction_size;
+
+    /// The size of a span
+    unsigned int span_size;
+
+    /// The size of the tape
+    unsigned int data_size;
+
+    /// The bfdb build that wrote the file, as passes that change between builds compile the same source differently
+    /// (see cache_build)
+    uint64_t build;
+
+    /// The hash of the source and the optimization level the program was compiled from (see cache_key)
+    uint64_t key;
+
+    /// The count of instructions
+    unsigned int count;
+
+    /// The count of brainfuck instructions in the source
+    unsigned int code_len;
+
+    /// The count of cells that are not zero on the initial tape
+    unsigned int cells;
+
+    /// The data pointer the program starts with
+    unsigned int init_ptr;
+
+    /// The program counter the program starts with
+    unsigned int init_pc;
+
+    /// The count of instructions that were executed ahead of time
+    unsigned long prefix_steps;
+
+    /// The hash of everything that follows the header, a file that was changed since it was written is not used
+    uint64_t checksum;
+} cache_header_t;
+
+/// A cell that is not zero on the initial tape, the rest of the tape is not stored
+typedef struct cache_cell_t {
+    /// The index of the cell
+    unsigned int index;
+
+    /// The value of the cell
+    unsigned int value;
+} cache_cell_t;
+
+/// Compiles the brainfuck program in fp like compile does, unless the same source was compiled with the same
+/// optimization level before, in which case the optimized program is read from the cache instead
+/// @param fp The file to read
+/// @param prog The program structure to write the program to
+/// @param cached Set to whether or not the program was read from the cache
+/// @return Whether or not the compilation succeeded
+bool compile_cached(FILE *fp, program_t *prog, bool *cached);
+
+/// Continues a 64 bit FNV-1a hash with more bytes
+/// @param hash The hash of the bytes before, CACHE_HASH_START if there are none
+/// @param bytes The bytes to hash
+/// @param size The count of bytes
+/// @return The hash of all bytes
+uint64_t cache_hash(uint64_t hash, const void *bytes, size_t size);
+
+/// Hashes a source together with the optimization level it is compiled with (64 bit FNV-1a)
+/// @param source The source
+/// @param size The size of the source in bytes
+/// @param level The optimization level
+/// @return The key of the compiled program in the cache
+uint64_t cache_key(const char *source, size_t size, int level);
+
+/// Checks that a compiled program holds the brainfuck instructions of the source it is stored under
+/// @param prog The compiled program
+/// @param source The source of the program
+/// @param size The size of the source in bytes
+/// @return Whether or not the program's brainfuck instructions are the ones of the source
+bool cache_matches(const program_t *prog, const char *source, size_t size);
+
+/// Checks that the OP_GUARD instructions and the IF_UNCHECKED flags of a program read from the cache are the ones
+/// hoist_bounds_checks puts in front of and into its loops with the current optimization level
+/// @param ir The instructions that were read
+/// @return Whether or not every unchecked access is covered by the guard of its loop
+bool cache_check_guards(const ir_t *ir);
+
+/// Identifies the build of bfdb by the time it was compiled at and its passes (64 bit FNV-1a)
+/// @return The identifier of the build
+uint64_t cache_build();
+
+/// Builds the path of a compiled program in the cache, in $XDG_CACHE_HOME or ~/.cache, creating its directory
+/// @param key The key of the program (see cache_key)
+/// @return The path, which has to be freed, or NULL if there is no cache directory or the system is not POSIX
+char *cache_path(uint64_t key);
+
+/// Maps a cache file and reads the program from it
+/// @param path The path of the cache file
+/// @param key The key the program has to have been stored with
+/// @param prog The program structure to write the program to, left as it is if the file cannot be used
+/// @return Whether or not the file held a valid program with the given key
+bool cache_read(const char *path, uint64_t key, program_t *prog);
+
+/// Writes a compiled program to a cache file
+/// @param path The path of the cache file
+/// @param key The key of the program
+/// @param prog The program to write
+/// @return Whether or not the file could be written
+bool cache_write(const char *path, uint64_t key, const program_t *prog);
+
 // bfdb vars
 
 /// Whether or not bfdb should continue running
@@ -83,6 +640,18 @@ static bool run = true;
 /// Whether or not a brainfuck program has been loaded
 static bool loaded = false;
 
+/// The name of the file the loaded program was read from
+static char *loaded_file = NULL;
+
+/// The optimization level programs are compiled with
+static int opt_level = DEFAULT_OPT_LEVEL;
+
+/// The indices of the brainfuck instructions the execution stops at
+static unsigned int breakpoints[BREAKPOINT_COUNT];
+
+/// The count of breakpoints
+static int breakpoint_count = 0;
+
 /// Running brainfuck instance
 typedef struct runtime_t {
     /// Whether or not brainfuck is currently running
@@ -92,14 +661,439 @@ typedef struct runtime_t {
     unsigned short data[DATA_SIZE];
 
     /// The program counter
-    unsigned short pc;
+    unsigned int pc;
 
     /// The data pointer
     unsigned int ptr;
+
+    /// Whether or not the last OP_GUARD found all cells of its loop on the tape
+    bool guarded;
+
+    /// Whether or not the data pointer is proven to stay on the tape, which makes all bounds checks unnecessary
+    bool bounded;
+
+    /// Set asynchronously (e.g. by SIGINT) to stop the execution, the engine checks it once per loop iteration
+    volatile sig_atomic_t stop;
+
+    /// The count of iterations after which a loop halts the threaded engine with HALT_HOT at its start, 0 if loops
+    /// never do
+    unsigned int hot;
+
+    /// The file ',' reads from
+    FILE *input;
+
+    /// The file '.' writes to
+    FILE *output;
 } runtime_t;
 
 /// The runtime currently associated with bfdb
-runtime_t runtime = { .running = false, .pc = 0, .ptr = 0 };
+runtime_t runtime = { .running = false, .pc = 0, .ptr = 0, .guarded = false, .bounded = false, .stop = 0, .hot = 0, .input = NULL, .output = NULL };
+
+/// The reasons an instruction halts the runtime
+enum {
+    HALT_NONE, HALT_END, HALT_OVERFLOW, HALT_UNDERFLOW, HALT_BREAK, HALT_INTERRUPT, HALT_HOT
+};
+
+/// Puts a runtime into the state a program starts in
+/// @param runtime The runtime to reset
+/// @param prog The program to start
+void runtime_reset(runtime_t *runtime, const program_t *prog);
+
+/// Executes an instruction on the given runtime without reporting anything
+/// @param runtime The runtime to use
+/// @param instruction The instruction to execute
+/// @return HALT_NONE or the reason the instruction halted the runtime, the program counter then stays at the instruction
+int runtime_exec(runtime_t *runtime, instruction_t instruction);
+
+/// Executes instructions of a program on the given runtime until it halts or has executed the given count of
+/// instructions, OP_GUARD is not counted as it is not part of the source. The runtime also halts before an instruction
+/// with a breakpoint, unless it is the first one executed, and at the next loop iteration once its stop flag is set.
+/// The threaded engine also halts at the start of a loop that got hot (see runtime_t's hot)
+/// @param runtime The runtime to use
+/// @param prog The program the runtime executes
+/// @param count The maximum count of instructions to execute
+/// @param executed The count of instructions that were executed, may be NULL
+/// @return HALT_NONE if the count was reached or the reason the runtime halted, exactly like runtime_exec
+int runtime_run(runtime_t *runtime, program_t *prog, unsigned long count, unsigned long *executed);
+
+/// Executes instructions of a program one runtime_exec at a time, halting exactly like runtime_run does but without
+/// decoding the program first
+/// @param runtime The runtime to use
+/// @param prog The program the runtime executes
+/// @param count The maximum count of instructions to execute
+/// @param executed The count of instructions that were executed, may be NULL
+/// @return HALT_NONE if the count was reached or the reason the runtime halted, exactly like runtime_exec
+int runtime_interpret(runtime_t *runtime, program_t *prog, unsigned long count, unsigned long *executed);
+
+/// Checks if the cell at the given offset from the data pointer is on the tape
+/// @param runtime The runtime to use
+/// @param offset The offset of the cell
+/// @return HALT_NONE or the reason the access halts the runtime, the data pointer then stays at the edge of the tape
+int runtime_check_offset(runtime_t *runtime, int offset);
+
+/// Moves the data pointer if the new position is on the tape
+/// @param runtime The runtime to use
+/// @param distance The signed distance to move the data pointer by
+/// @return HALT_NONE or the reason the movement halts the runtime, the data pointer then stays at the edge of the tape
+int runtime_move(runtime_t *runtime, int distance);
+
+/// Executes the program ahead of time up to its first input or output and stores the resulting state as its initial state
+/// @param prog The program to evaluate
+void evaluate_prefix(program_t *prog);
+
+// Engines
+
+/// The state of a runtime the debugger reads and changes, whichever engine executed it
+typedef struct engine_state_t {
+    /// The program counter
+    unsigned int pc;
+
+    /// The data pointer
+    unsigned int ptr;
+
+    /// The cells of the runtime itself, the debugger changes them in place
+    unsigned short *data;
+} engine_state_t;
+
+/// A way of executing programs, all of them leave the runtime in exactly the same state
+typedef struct engine_t {
+    /// The engine's name
+    const char *name;
+
+    /// The engine's description
+    const char *desc;
+
+    /// Prepares a program to be executed by the engine
+    /// @param prog The program to prepare
+    /// @return Whether or not the engine is available on this platform
+    bool (*init)(program_t *prog);
+
+    /// Executes the next instruction
+    /// @param runtime The runtime to use
+    /// @param prog The program the runtime executes
+    /// @return HALT_NONE or the reason the runtime halted (see runtime_run)
+    int (*step)(runtime_t *runtime, program_t *prog);
+
+    /// Executes instructions until the runtime halts or has executed the given count of instructions
+    /// @param runtime The runtime to use
+    /// @param prog The program the runtime executes
+    /// @param count The maximum count of instructions to execute, ULONG_MAX to run until the runtime halts
+    /// @return HALT_NONE or the reason the runtime halted (see runtime_run)
+    int (*run_until)(runtime_t *runtime, program_t *prog, unsigned long count);
+
+    /// Reads the state the engine left the runtime in
+    /// @param runtime The runtime to read
+    /// @param state The state to fill
+    void (*read_state)(runtime_t *runtime, engine_state_t *state);
+
+    /// Changes the state of the runtime, e.g. after the debugger changed the data pointer
+    /// @param runtime The runtime to change
+    /// @param state The new state
+    void (*write_state)(runtime_t *runtime, const engine_state_t *state);
+} engine_t;
+
+/// Prepares a program for an engine that needs no preparation
+/// @param prog The program to prepare
+/// @return true
+bool engine_init(program_t *prog);
+
+/// Prepares a program for the native engine
+/// @param prog The program to prepare
+/// @return Whether or not native code can be generated on this platform
+bool engine_native_init(program_t *prog);
+
+/// Executes the next instruction with runtime_interpret
+/// @param runtime The runtime to use
+/// @param prog The program the runtime executes
+/// @return HALT_NONE or the reason the runtime halted (see runtime_run)
+int engine_interpreter_step(runtime_t *runtime, program_t *prog);
+
+/// Executes instructions with runtime_interpret
+/// @param runtime The runtime to use
+/// @param prog The program the runtime executes
+/// @param count The maximum count of instructions to execute
+/// @return HALT_NONE or the reason the runtime halted (see runtime_run)
+int engine_interpreter_run(runtime_t *runtime, program_t *prog, unsigned long count);
+
+/// Executes the next instruction with runtime_run
+/// @param runtime The runtime to use
+/// @param prog The program the runtime executes
+/// @return HALT_NONE or the reason the runtime halted (see runtime_run)
+int engine_threaded_step(runtime_t *runtime, program_t *prog);
+
+/// Executes instructions with runtime_run
+/// @param runtime The runtime to use
+/// @param prog The program the runtime executes
+/// @param count The maximum count of instructions to execute
+/// @return HALT_NONE or the reason the runtime halted (see runtime_run)
+int engine_threaded_run(runtime_t *runtime, program_t *prog, unsigned long count);
+
+/// Executes instructions with jit_run when running until the runtime halts and with runtime_run otherwise, as
+/// native code cannot stop after a count of instructions
+/// @param runtime The runtime to use
+/// @param prog The program the runtime executes
+/// @param count The maximum count of instructions to execute
+/// @return HALT_NONE or the reason the runtime halted (see runtime_run)
+int engine_native_run(runtime_t *runtime, program_t *prog, unsigned long count);
+
+/// Reads the state of a runtime, which all engines keep in runtime_t
+/// @param runtime The runtime to read
+/// @param state The state to fill
+void engine_read_state(runtime_t *runtime, engine_state_t *state);
+
+/// Changes the program counter and the data pointer of a runtime, which all engines keep in runtime_t. The cells are
+/// changed in place through the state's data. The guard and the bounds analysis have not seen a data pointer or
+/// program counter that is changed
+/// @param runtime The runtime to change
+/// @param state The new state
+void engine_write_state(runtime_t *runtime, const engine_state_t *state);
+
+/// The engines
+static const engine_t engines[] = {
+    { .name = "interpreter", .desc = "Executes one instruction at a time",                   .init = &engine_init,        .step = &engine_interpreter_step, .run_until = &engine_interpreter_run, .read_state = &engine_read_state, .write_state = &engine_write_state },
+    { .name = "threaded",    .desc = "Dispatches the decoded instructions with direct jumps", .init = &engine_init,        .step = &engine_threaded_step,    .run_until = &engine_threaded_run,    .read_state = &engine_read_state, .write_state = &engine_write_state },
+    { .name = "native",      .desc = "Switches to x86-64 code once a loop gets hot",         .init = &engine_native_init, .step = &engine_threaded_step,    .run_until = &engine_native_run,      .read_state = &engine_read_state, .write_state = &engine_write_state }
+};
+
+/// The engine the debugger executes programs with
+static const engine_t *engine = &engines[DEFAULT_ENGINE];
+
+// Native code
+
+/// The native code of a program while it is generated
+typedef struct jit_asm_t {
+    /// The generated code
+    unsigned char *bytes;
+
+    /// The size of the generated code in bytes
+    size_t size;
+
+    /// The count of bytes the buffer has room for
+    size_t capacity;
+
+    /// The offset of each instruction's code
+    size_t *offsets;
+
+    /// Whether the code is a standalone executable (see emit_elf) rather than called by jit_run
+    bool standalone;
+
+    /// The offset of the epilogue, which stores the data pointer and the program counter in esi and returns
+    size_t epilogue;
+
+    /// The offset of the standalone executable's routine that writes the buffered output
+    size_t flush;
+
+    /// The offset of the standalone executable's routine that reports a runtime error and exits
+    size_t fail;
+
+    /// The offset of the code that leaves the native code at an instruction that failed its bounds check, 0 if the
+    /// instruction does not have one yet
+    size_t *faults;
+
+    /// The jumps whose target is not known yet (see jit_patch_t)
+    struct jit_patch_t *patches;
+
+    /// The count of jumps whose target is not known yet
+    unsigned int patch_count;
+
+    /// The count of jumps the patch buffer has room for
+    unsigned int patch_capacity;
+} jit_asm_t;
+
+/// A 32 bit jump displacement that is filled in once its target is known
+typedef struct jit_patch_t {
+    /// The offset of the displacement
+    size_t at;
+
+    /// The instruction whose code or fault exit is jumped to
+    unsigned int pc;
+
+    /// Whether the jump goes to the instruction's fault exit instead of its code
+    bool fault;
+} jit_patch_t;
+
+/// The entry point of native code, returns the reason the runtime halted or JIT_FAULT
+typedef int (*jit_entry_t)(runtime_t *runtime, const void *start);
+
+/// Returned by native code that stopped in front of an instruction whose bounds check failed
+#define JIT_FAULT -1
+
+/// Runs the loaded program until it halts, starting in the threaded engine and switching to native code at the start
+/// of the first loop that gets hot, which falls back to runtime_run where native code is not supported. The native
+/// code checks the runtime's stop flag at the loops' ends and stops at breakpoints just like runtime_run does
+/// @param runtime The runtime to use
+/// @param prog The program the runtime executes
+/// @return The reason the runtime halted, exactly like runtime_exec
+int jit_run(runtime_t *runtime, program_t *prog);
+
+/// Compiles a program to x86-64 code in an executable mapping. Cells are accessed relative to the data pointer in
+/// r12, the tape's address is kept in rbx and the runtime's in r13, '.' and ',' call fputc and getc
+/// @param prog The program to compile
+/// @param checked Whether or not the code should check that the data pointer stays on the tape
+/// @return The native code or NULL if no executable memory could be mapped
+jit_t *jit_compile(const program_t *prog, bool checked);
+
+/// Frees native code
+/// @param jit The native code to free, may be NULL
+void jit_free(jit_t *jit);
+
+/// Appends bytes to the native code, growing the buffer if it is full
+/// @param a The code to append to
+/// @param bytes The bytes to append
+/// @param count The count of bytes
+void jit_emit(jit_asm_t *a, const void *bytes, size_t count);
+
+/// Appends a 32 bit little endian value to the native code
+/// @param a The code to append to
+/// @param value The value to append
+void jit_emit32(jit_asm_t *a, int32_t value);
+
+/// Appends a jump displacement to the native code that is filled in once the code or fault exit of its instruction
+/// has been generated
+/// @param a The code to append to
+/// @param pc The instruction to jump to
+/// @param fault Whether to jump to the instruction's fault exit instead of its code
+void jit_emit_target(jit_asm_t *a, unsigned int pc, bool fault);
+
+/// Appends the operand [rbx + r12 * 2 + offset * 2], which addresses the cell at the given offset from the data
+/// pointer, together with the register or opcode extension of the instruction
+/// @param a The code to append to
+/// @param reg The register or opcode extension
+/// @param offset The offset of the cell
+void jit_emit_cell(jit_asm_t *a, int reg, int offset);
+
+/// Appends code that leaves the native code at an instruction
+/// @param a The code to append to
+/// @param pc The instruction the runtime stops at
+/// @param halt The reason the runtime halts
+void jit_emit_exit(jit_asm_t *a, unsigned int pc, int halt);
+
+/// Appends a bounds check of the cell at the given offset from the data pointer, which leaves the index of the cell
+/// in rcx
+/// @param a The code to append to
+/// @param pc The instruction that accesses the cell
+/// @param offset The offset of the cell
+void jit_emit_check(jit_asm_t *a, unsigned int pc, long offset);
+
+/// Appends code that moves the data pointer
+/// @param a The code to append to
+/// @param pc The instruction that moves the data pointer
+/// @param distance The signed distance to move the data pointer by
+/// @param checked Whether or not the new position is checked
+void jit_emit_move(jit_asm_t *a, unsigned int pc, long distance, bool checked);
+
+/// Appends code that loads the current cell into eax and tests it for zero
+/// @param a The code to append to
+void jit_emit_test(jit_asm_t *a);
+
+/// Appends a call of a C function, the arguments have to be in rdi, rsi and rdx already
+/// @param a The code to append to
+/// @param function The address of the function
+void jit_emit_call(jit_asm_t *a, uintptr_t function);
+
+/// Appends the end of a loop that jumps back to the instruction after its start while the current cell is not zero,
+/// the stop flag is checked on the way back
+/// @param a The code to append to
+/// @param start The instruction after the loop's start
+void jit_emit_loop_end(jit_asm_t *a, unsigned int start);
+
+/// Appends a relative call of one of the standalone executable's routines
+/// @param a The code to append to
+/// @param routine The offset of the routine
+void jit_emit_call_routine(jit_asm_t *a, size_t routine);
+
+/// Appends the exit syscall of a standalone executable
+/// @param a The code to append to
+/// @param status The exit status
+void jit_emit_exit_process(jit_asm_t *a, int status);
+
+/// Appends the exit of a standalone executable at an instruction whose bounds check failed, the index of the cell
+/// that is off the tape has to be in rcx
+/// @param a The code to append to
+/// @param prog The program the instruction belongs to
+/// @param pc The instruction
+void jit_emit_fail(jit_asm_t *a, const program_t *prog, unsigned int pc);
+
+/// Generates the code of every instruction, followed by the exits of the instructions whose bounds check failed
+/// @param a The code to append to, its prologue has to be generated already
+/// @param prog The program to generate the code of
+/// @param checked Whether or not the code should check that the data pointer stays on the tape
+void jit_generate(jit_asm_t *a, const program_t *prog, bool checked);
+
+/// Writes a program as a static x86-64 Linux executable that needs neither bfdb nor libc, using the code generator
+/// of jit_compile. Its output is buffered and written with the write syscall, runtime errors are reported like
+/// dbg_runtime_error does, without the cell's value, and make it exit with 1
+/// @param fp The file to write to
+/// @param prog The program to write
+/// @return Whether or not the executable could be written, which it cannot on other platforms
+bool emit_elf(FILE *fp, const program_t *prog);
+
+// C code
+
+/// Writes a program as a standalone C program that behaves exactly like runtime_exec, including the bounds checks and
+/// the messages of dbg_runtime_error
+/// @param fp The file to write to
+/// @param prog The program to write
+/// @param name The name of the file the program was read from
+void emit_c(FILE *fp, const program_t *prog, const char *name);
+
+/// Writes the index of a cell relative to the data pointer, e.g. 'ptr + 2'
+/// @param fp The file to write to
+/// @param offset The offset of the cell
+void emit_c_cell(FILE *fp, int offset);
+
+/// Writes the bounds check of a cell, which reports the error at the given instruction, as a statement
+/// @param fp The file to write to
+/// @param prog The program the instruction belongs to
+/// @param pc The instruction that accesses the cell
+/// @param offset The offset of the cell
+/// @param guarded Whether or not the check is skipped if the guard of the instruction's loop passed
+void emit_c_check(FILE *fp, const program_t *prog, unsigned int pc, int offset, bool guarded);
+
+// Optimization passes
+
+/// A pass that rewrites or analyzes the program during compilation, exactly one of rewrite and analyze is set
+typedef struct pass_t {
+    /// The name of the pass
+    const char *name;
+
+    /// The lowest optimization level the pass runs at
+    int level;
+
+    /// The function that writes the rewritten program to a new buffer, which then replaces the program's instructions
+    void (*rewrite)(const program_t *prog, ir_t *out);
+
+    /// The function that inspects the program without changing its instructions
+    void (*analyze)(program_t *prog);
+
+    /// The count of instructions before the pass during the last compilation
+    unsigned int before;
+
+    /// The count of instructions after the pass during the last compilation
+    unsigned int after;
+
+    /// The time the pass took during the last compilation in milliseconds
+    double time;
+} pass_t;
+
+/// The passes in the order they run in
+pass_t passes[] = {
+    { .name = "dead-code",         .level = 1, .rewrite = &remove_dead_code    },
+    { .name = "fold-runs",         .level = 1, .rewrite = &fold_runs           },
+    { .name = "clear-loops",       .level = 2, .rewrite = &fold_clear_loops    },
+    { .name = "muladd-loops",      .level = 2, .rewrite = &fold_muladd_loops   },
+    { .name = "scan-loops",        .level = 2, .rewrite = &fold_scan_loops     },
+    { .name = "offsets",           .level = 2, .rewrite = &fold_offsets        },
+    { .name = "constants",         .level = 2, .rewrite = &fold_constants      },
+    { .name = "stores",            .level = 2, .rewrite = &fold_stores         },
+    { .name = "superinstructions", .level = 2, .rewrite = &fuse_instructions   },
+    { .name = "bounds-checks",     .level = 2, .rewrite = &hoist_bounds_checks },
+    { .name = "bounds",            .level = 2, .analyze = &analyze_bounds      },
+    { .name = "prefix",            .level = 3, .analyze = &evaluate_prefix     }
+};
+
+/// The count of passes
+const int pass_count = sizeof(passes) / sizeof(pass_t);
 
 // Commands
 
@@ -149,9 +1143,13 @@ void cmd_next(char *count);
 /// @param index The index of the instruction to jump to
 void cmd_jump(char *index);
 
-/// The continue command, continues the execution until the end or until a runtime error occurs
+/// The continue command, continues the execution until the end, a runtime error, a breakpoint or an interrupt
 void cmd_continue(char *unused);
 
+/// The break command, sets or deletes a breakpoint or lists the breakpoints
+/// @param index The index of the instruction to set or delete the breakpoint at
+void cmd_break(char *index);
+
 /// The dataptr command, prints the data pointer
 void cmd_dataptr(char *unused);
 
@@ -166,6 +1164,25 @@ void cmd_tape(char *unused);
 /// @param value The value to set the cell to
 void cmd_set(char *value);
 
+/// The engine command, prints the engines or sets the one programs are executed with
+/// @param name The name of the engine, NULL to print the engines
+void cmd_engine(char *name);
+
+/// The optimize command, prints or sets the optimization level and recompiles the loaded program
+/// @param level The optimization level to use
+void cmd_optimize(char *level);
+
+/// The info command, prints what bfdb knows about the loaded program
+void cmd_info(char *unused);
+
+/// The emit-c command, writes the loaded program as a standalone C program
+/// @param file_name The name of the file to write
+void cmd_emit_c(char *file_name);
+
+/// The emit-elf command, writes the loaded program as a standalone executable
+/// @param file_name The name of the file to write
+void cmd_emit_elf(char *file_name);
+
 /// The commands
 command_t commands[] = {
     { .name = "help",     .abbr = 'h', .desc = "Print this help",                       .arg_desc = NULL,             .handler = &cmd_help     },
@@ -175,10 +1192,16 @@ command_t commands[] = {
     { .name = "next",     .abbr = 'n', .desc = "Steps instructions",                    .arg_desc = "[count = 1]",    .handler = &cmd_next     },
     { .name = "jump",     .abbr = 'j', .desc = "Jumps to an instruction",               .arg_desc = "<instr_index>",  .handler = &cmd_jump     },
     { .name = "continue", .abbr = 'c', .desc = "Continue execution",                    .arg_desc = NULL,             .handler = &cmd_continue },
+    { .name = "break",    .abbr = 'b', .desc = "Sets or deletes a breakpoint",          .arg_desc = "[instr_index]",  .handler = &cmd_break    },
     { .name = "dataptr",  .abbr = 'd', .desc = "Prints or sets the data pointer",       .arg_desc = "[ptr]",          .handler = &cmd_dataptr  },
     { .name = "print",    .abbr = 'p', .desc = "Print cell",                            .arg_desc = "[index = $ptr]", .handler = &cmd_print    },
     { .name = "tape",     .abbr = 't', .desc = "View the tape around the data pointer", .arg_desc = NULL,             .handler = &cmd_tape     },
-    { .name = "set",      .abbr = 's', .desc = "Sets the value of the current cell",    .arg_desc = "<value>",        .handler = &cmd_set      }
+    { .name = "set",      .abbr = 's', .desc = "Sets the value of the current cell",    .arg_desc = "<value>",        .handler = &cmd_set      },
+    { .name = "optimize", .abbr = 'o', .desc = "Prints or sets the optimization level", .arg_desc = "[level]",        .handler = &cmd_optimize },
+    { .name = "engine",   .abbr = 'g', .desc = "Prints or sets the execution engine",   .arg_desc = "[name]",         .handler = &cmd_engine   },
+    { .name = "info",     .abbr = 'i', .desc = "Prints information about the program",  .arg_desc = NULL,             .handler = &cmd_info     },
+    { .name = "emit-c",   .abbr = 'e', .desc = "Writes the program as C code",          .arg_desc = "<filename>",     .handler = &cmd_emit_c   },
+    { .name = "emit-elf", .abbr = 'l', .desc = "Writes the program as an executable",   .arg_desc = "<filename>",     .handler = &cmd_emit_elf }
 };
 
 /// The count of available commands
@@ -190,6 +1213,27 @@ const int command_count = sizeof(commands) / sizeof(command_t);
 /// @param file_name The name of the file
 void dbg_load(const char *const file_name);
 
+/// Sets the optimization level used for the next compilation
+/// @param level The optimization level
+/// @return Whether or not the level is valid
+bool dbg_set_opt_level(int level);
+
+/// Prints the size of the loaded program and whether or not it runs with bounds checks
+void dbg_print_info();
+
+/// Writes the loaded program as a standalone C program
+/// @param file_name The name of the file to write
+/// @return Whether or not the file could be written
+bool dbg_emit_c(const char *const file_name);
+
+/// Writes the loaded program as a standalone executable
+/// @param file_name The name of the file to write
+/// @return Whether or not the file could be written
+bool dbg_emit_elf(const char *const file_name);
+
+/// Prints the instruction counts and times of the passes that ran during the last compilation
+void dbg_print_pass_stats();
+
 /// Prints a formatted error as well as runtime information to stderr and stops execution
 /// @param fmt The format
 void dbg_runtime_error(const char *fmt, ...);
@@ -197,22 +1241,52 @@ void dbg_runtime_error(const char *fmt, ...);
 /// Start execution of the loaded brainfuck program
 void dbg_run();
 
-/// Interprets an instruction on the given runtime
-/// @param runtime The runtime to use
-/// @param instruction The instruction to interpret
+/// Reports why the runtime halted, if it did
+/// @param runtime The runtime that was executed
+/// @param halt The reason the runtime halted (see runtime_exec)
 /// @return Whether the runtime was terminated either by OP_END or a runtime error
-bool dbg_interpret(runtime_t *runtime, instruction_t instruction);
+bool dbg_halt(runtime_t *runtime, int halt);
+
+/// Executes the loaded program with the current engine until it halts or has executed the given count of
+/// instructions, SIGINT stops it at the next loop iteration meanwhile. A count of 1 steps the engine
+/// @param count The maximum count of instructions to execute
+/// @return HALT_NONE or the reason the runtime halted (see runtime_run)
+int dbg_execute(unsigned long count);
+
+/// Handles SIGINT while the program is executed by asking the runtime to stop
+/// @param signal The signal that was raised
+void dbg_interrupt(int signal);
 
 /// Steps in execution
 /// @param count The count of instructions to step
 /// @return Whether the interpretation of the instructions terminated the runtime (see dbg_interpret's return)
 bool dbg_next(int count);
 
-/// Jumps to the instruction at the given index
+/// Jumps to the instruction that was compiled from the brainfuck instruction at the given index
 /// @param prog The current running program
-/// @param index The index of the instruction to jump to
+/// @param index The index of the brainfuck instruction in the source to jump to
 void dbg_jump(program_t *prog, int index);
 
+/// Sets a breakpoint at the given brainfuck instruction or deletes the breakpoint that is already set there
+/// @param prog The loaded program
+/// @param index The index of the brainfuck instruction in the source
+void dbg_toggle_breakpoint(program_t *prog, int index);
+
+/// Prints the breakpoints
+void dbg_print_breakpoints();
+
+/// Marks the instructions that the breakpoints were compiled to, which has to be redone after each compilation
+/// @param prog The program to mark
+void dbg_apply_breakpoints(program_t *prog);
+
+/// Prints the engines, marking the current one
+void dbg_print_engines();
+
+/// Sets the engine programs are executed with, the state of a running program carries over
+/// @param name The name of the engine
+/// @return Whether or not the engine exists and is available
+bool dbg_set_engine(const char *const name);
+
 /// Prints the data pointer
 void dbg_print_dataptr();
 
@@ -235,13 +1309,111 @@ void dbg_print_op();
 /// @param value The value to set the cell to
 void dbg_set_cell(int index, unsigned short value);
 
+// Differential testing
+
+/// The outcomes of comparing a program's optimized execution with its unoptimized one
+enum {
+    DIFF_SAME, DIFF_DIVERGED, DIFF_SKIPPED
+};
+
+/// How a program ended in the differential test
+typedef struct diff_result_t {
+    /// HALT_END, the runtime error or HALT_NONE if the program ran out of steps
+    int halt;
+
+    /// The count of instructions executed, including the ones executed ahead of time
+    unsigned long steps;
+
+    /// The span of the instruction the program halted at
+    span_t span;
+
+    /// The output of the program
+    FILE *output;
+} diff_result_t;
+
+/// Runs every .bf file in a directory unoptimized and at the current optimization level and compares the outputs, the
+/// final tapes and the positions of runtime errors, a file's input is read from the .in file of the same name
+/// @param dir_name The directory to test
+/// @return Whether or not all programs behaved the same at both levels
+bool diff_directory(const char *dir_name);
+
+/// Compares two file names for qsort
+/// @param a The first name
+/// @param b The second name
+/// @return The order of the names
+int diff_compare_names(const void *a, const void *b);
+
+/// Compares a program's unoptimized execution with the one at the current optimization level and reports the first
+/// divergence
+/// @param file_name The program to test
+/// @param input_name The file to read the input from, empty input is used if it does not exist
+/// @return DIFF_SAME, DIFF_DIVERGED or DIFF_SKIPPED if the program could not be compared
+int diff_program(const char *file_name, const char *input_name);
+
+/// Compiles and runs a program without the debugger
+/// @param file_name The program to run
+/// @param input_name The file to read the input from
+/// @param level The optimization level to compile with
+/// @param prog The program structure to compile to
+/// @param runtime The runtime to run on
+/// @param result How the program ended
+/// @return Whether or not the program could be compiled and its input and output files could be opened
+bool diff_run(const char *file_name, const char *input_name, int level, program_t *prog, runtime_t *runtime, diff_result_t *result);
+
 /// The programs entry point
 /// @param argc The argument count
 /// @param argv A c-string array of the arguments
 /// @returns The exit code
 int main(int argc, char **argv) {
-    if (argc > 1) {
-        dbg_load(argv[1]);
+    /// The file given on the command line
+    const char *file_name = NULL;
+    /// The directory to run the differential test on
+    const char *diff_dir = NULL;
+    /// The file to write the program to as C code
+    const char *c_file = NULL;
+    /// The file to write the program to as an executable
+    const char *elf_file = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--diff") == 0) {
+            if (i + 1 == argc) {
+                fprintf(stderr, "\x1B[31mError\x1B[0m: '--diff' takes exactly one directory argument.\n");
+                return EXIT_FAILURE;
+            }
+            diff_dir = argv[++i];
+        } else if (strcmp(argv[i], "--emit-c") == 0) {
+            if (i + 1 == argc) {
+                fprintf(stderr, "\x1B[31mError\x1B[0m: '--emit-c' takes exactly one file path argument.\n");
+                return EXIT_FAILURE;
+            }
+            c_file = argv[++i];
+        } else if (strcmp(argv[i], "--emit-elf") == 0) {
+            if (i + 1 == argc) {
+                fprintf(stderr, "\x1B[31mError\x1B[0m: '--emit-elf' takes exactly one file path argument.\n");
+                return EXIT_FAILURE;
+            }
+            elf_file = argv[++i];
+        } else if (strncmp(argv[i], "-O", 2) == 0) {
+            int level;
+            if (to_int(&argv[i][2], 10, false, &level)) {
+                dbg_set_opt_level(level);
+            }
+        } else {
+            file_name = argv[i];
+        }
+    }
+
+    if (diff_dir) {
+        return diff_directory(diff_dir) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (file_name) {
+        dbg_load(file_name);
+    }
+
+    if (c_file || elf_file) {
+        bool written = loaded && (!c_file || dbg_emit_c(c_file)) && (!elf_file || dbg_emit_elf(elf_file));
+        return written ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
     while (run) {
@@ -314,6 +1486,43 @@ bool to_int(const char *const str, int base, bool allow_neg, int *converted) {
     }
 }
 
+long scan_tape(const unsigned short *data, long index, int stride) {
+    /// The high bit of each of the four cells in a 64 bit word
+    const uint64_t high = 0x8000800080008000;
+    /// The low bit of each of the four cells in a 64 bit word
+    const uint64_t low = 0x0001000100010001;
+
+    uint64_t word;
+
+    // Skip four cells at a time until a word contains a zero cell, the exact cell is then found one by one
+    if (stride == 1) {
+        while (index + 4 <= DATA_SIZE) {
+            memcpy(&word, &data[index], sizeof(word));
+            if ((word - low) & ~word & high) {
+                break;
+            }
+            index += 4;
+        }
+    } else if (stride == -1) {
+        while (index >= 3) {
+            memcpy(&word, &data[index - 3], sizeof(word));
+            if ((word - low) & ~word & high) {
+                break;
+            }
+            index -= 4;
+        }
+    }
+
+    while (index >= 0 && index < DATA_SIZE) {
+        if (!data[index]) {
+            return index;
+        }
+        index += stride;
+    }
+
+    return -1;
+}
+
 bool dataptr_in_range(int index) {
     if (index < 0 || index >= DATA_SIZE) {
         fprintf(stderr, "%d: Not in range [0..%d).\n", index, DATA_SIZE);
@@ -323,103 +1532,3141 @@ bool dataptr_in_range(int index) {
     }
 }
 
-bool compile(FILE *fp, program_t *prog) {
-    // Make sure that a program structure is provided
-    if (!prog) {
-        return false;
-    }
+bool close_written(FILE *fp, const char *const file_name) {
+    bool written = !ferror(fp);
+    written = fclose(fp) == 0 && written;
 
-    /// The current line in the file
-    int line = 1;
-    /// The current column in the file
-    int col = 1;
+    if (!written) {
+        fprintf(stderr, "%s: Could not write file.\n", file_name);
 
-    /// The stack that is used to keep track of jumps during compilation
-    unsigned short stack[STACK_SIZE];
-    /// The stack pointer
-    unsigned int esp = 0;
+#ifdef POSIX
+        // Only a regular file is left half written, a device such as /dev/stdout must stay
+        struct stat status;
+        if (stat(file_name, &status) == 0 && S_ISREG(status.st_mode)) {
+            remove(file_name);
+        }
+#else
+        remove(file_name);
+#endif
+    }
 
-    unsigned short pc = 0;
-    unsigned short jmp_pc;
+    return written;
+}
 
-    int c;
-    while ((c = getc(fp)) != EOF && pc < PROGRAM_SIZE) {
-        switch (c) {
-            case '>':
-                prog->instructions[pc].operator = OP_INC;
-                break;
-            case '<':
-                prog->instructions[pc].operator = OP_DEC;
-                break;
-            case '+':
-                prog->instructions[pc].operator = OP_ADD;
-                break;
-            case '-':
-                prog->instructions[pc].operator = OP_SUB;
-                break;
-            case '.':
-                prog->instructions[pc].operator = OP_OUT;
-                break;
-            case ',':
-                prog->instructions[pc].operator = OP_IN;
-                break;
-            case '[':
-                prog->instructions[pc].operator = OP_JMP;
-                if (esp == STACK_SIZE) {
-                    compile_error(line, col, "loop count exceeds bfdb's capacity (%d).\n", STACK_SIZE);
-                    return false;
-                }
-                stack[esp++] = pc;
-                break;
-            case ']':
-                if (esp == 0) {
-                    compile_error(line, col, "unmatched ']'.\n");
-                    return false;
-                }
-                jmp_pc = stack[--esp];
-                prog->instructions[pc].operator = OP_RET;
-                prog->instructions[pc].operand = jmp_pc;
-                prog->instructions[jmp_pc].operand = pc;
-                break;
-            default:
-                pc--;
-                break;
-        }
+void runtime_reset(runtime_t *runtime, const program_t *prog) {
+    // Start from the state the input-independent prefix of the program left behind
+    memcpy(runtime->data, prog->init_data, sizeof(unsigned short) * DATA_SIZE);
 
-        pc++;
+    runtime->pc = prog->init_pc;
+    runtime->ptr = prog->init_ptr;
+    runtime->guarded = false;
+    runtime->bounded = prog->bounds == BOUNDS_PROVEN;
+    runtime->stop = 0;
+}
 
-        if (c == '\n') {
-            col = 1;
-            line++;
-        } else {
-            col++;
-        }
-    }
+int runtime_exec(runtime_t *runtime, instruction_t instruction) {
+    /// The reason the instruction halted the runtime
+    int halt = HALT_NONE;
+    /// Whether or not the guard of the instruction's loop already checked the cells it accesses
+    bool unchecked = runtime->bounded || ((instruction.flags & IF_UNCHECKED) && runtime->guarded);
 
-    if (pc == PROGRAM_SIZE) {
-        compile_error(line, col, "instruction count exceeds bfdb's capacity (%d).\n", PROGRAM_SIZE);
-        return false;
+    switch (instruction.operator) {
+        case OP_END:
+            return HALT_END;
+        case OP_INC:
+            if (unchecked) {
+                runtime->ptr += instruction.operand;
+            } else if ((halt = runtime_move(runtime, instruction.operand))) {
+                return halt;
+            }
+            break;
+        case OP_DEC:
+            if (unchecked) {
+                runtime->ptr -= instruction.operand;
+            } else if ((halt = runtime_move(runtime, -(int) instruction.operand))) {
+                return halt;
+            }
+            break;
+        case OP_ADD:
+            if (!unchecked && (halt = runtime_check_offset(runtime, instruction.offset))) {
+                return halt;
+            }
+            runtime->data[runtime->ptr + instruction.offset] += instruction.operand;
+            break;
+        case OP_SUB:
+            if (!unchecked && (halt = runtime_check_offset(runtime, instruction.offset))) {
+                return halt;
+            }
+            runtime->data[runtime->ptr + instruction.offset] -= instruction.operand;
+            break;
+        case OP_OUT:
+            if (!unchecked && (halt = runtime_check_offset(runtime, instruction.offset))) {
+                return halt;
+            }
+            fputc(runtime->data[runtime->ptr + instruction.offset], runtime->output);
+            break;
+        case OP_IN:
+            if (!unchecked && (halt = runtime_check_offset(runtime, instruction.offset))) {
+                return halt;
+            }
+            runtime->data[runtime->ptr + instruction.offset] = (unsigned int) getc(runtime->input);
+            break;
+        case OP_JMP:
+            if (!runtime->data[runtime->ptr]) {
+                runtime->pc = instruction.operand;
+            }
+            break;
+        case OP_RET:
+            if (runtime->data[runtime->ptr]) {
+                runtime->pc = instruction.operand;
+            }
+            break;
+        case OP_MOVE_JMP:
+            if (unchecked) {
+                runtime->ptr += instruction.offset;
+            } else if ((halt = runtime_move(runtime, instruction.offset))) {
+                return halt;
+            }
+            if (!runtime->data[runtime->ptr]) {
+                runtime->pc = instruction.operand;
+            }
+            break;
+        case OP_MOVE_RET:
+            if (unchecked) {
+                runtime->ptr += instruction.offset;
+            } else if ((halt = runtime_move(runtime, instruction.offset))) {
+                return halt;
+            }
+            if (runtime->data[runtime->ptr]) {
+                runtime->pc = instruction.operand;
+            }
+            break;
+        case OP_CLEAR:
+            if (!unchecked && (halt = runtime_check_offset(runtime, instruction.offset))) {
+                return halt;
+            }
+            runtime->data[runtime->ptr + instruction.offset] = 0;
+            break;
+        case OP_SET:
+            if (!unchecked && (halt = runtime_check_offset(runtime, instruction.offset))) {
+                return halt;
+            }
+            runtime->data[runtime->ptr + instruction.offset] = instruction.operand;
+            break;
+        case OP_MULADD:
+            // The loop would not have been entered for an empty cell, so neither are its bounds checked
+            if (runtime->data[runtime->ptr]) {
+                if (!unchecked && (halt = runtime_check_offset(runtime, instruction.offset))) {
+                    return halt;
+                }
+                runtime->data[runtime->ptr + instruction.offset] += (unsigned int) instruction.operand * runtime->data[runtime->ptr];
+            }
+            break;
+        case OP_SCAN:
+            if (runtime->data[runtime->ptr]) {
+                long found = scan_tape(runtime->data, (long) runtime->ptr + instruction.offset, instruction.offset);
+
+                // Stop at the last cell in the scan's direction, just like stepping one cell at a time would have
+                if (found < 0 && instruction.offset > 0) {
+                    runtime->ptr = DATA_SIZE - 1;
+                    return HALT_OVERFLOW;
+                } else if (found < 0) {
+                    runtime->ptr = 0;
+                    return HALT_UNDERFLOW;
+                }
+
+                runtime->ptr = found;
+            }
+            break;
+        case OP_MULMUL:
+            if (!unchecked && ((halt = runtime_check_offset(runtime, instruction.offset))
+                    || (halt = runtime_check_offset(runtime, instruction.source)))) {
+                return halt;
+            }
+            runtime->data[runtime->ptr + instruction.offset] += (unsigned int) instruction.operand * runtime->data[runtime->ptr]
+                                                                * runtime->data[runtime->ptr + instruction.source];
+            break;
+        case OP_GUARD: {
+            long lowest = (long) runtime->ptr + instruction.offset;
+            long highest = lowest + instruction.operand;
+
+            // If a cell is off the tape the body is checked as usual, which reports the error at the exact instruction
+            runtime->guarded = lowest >= 0 && highest < DATA_SIZE;
+            break;
+        }
+    }
+
+    runtime->pc++;
+
+    return HALT_NONE;
+}
+
+#ifdef __GNUC__
+
+int runtime_run(runtime_t *runtime, program_t *prog, unsigned long count, unsigned long *executed) {
+    /// The code of each operator, indexed like INSTRUCTIONS
+    static const void *const labels[] = {
+        &&op_end, &&op_inc, &&op_dec, &&op_add, &&op_sub, &&op_out, &&op_in, &&op_jmp, &&op_ret, &&op_clear, &&op_muladd,
+        &&op_scan, &&op_move_jmp, &&op_move_ret, &&op_guard, &&op_mulmul, &&op_set
+    };
+
+    // Decode the program once, so that dispatching an instruction is a single indirect jump
+    if (!prog->threaded) {
+        prog->threaded = (threaded_t*) malloc(sizeof(threaded_t) * prog->ir.count);
+
+        for (unsigned int i = 0; i < prog->ir.count; ++i) {
+            instruction_t instruction = prog->ir.instructions[i];
+
+            // Breakpoints trap into op_break instead of being checked on every instruction
+            prog->threaded[i].label = (instruction.flags & IF_BREAK) ? &&op_break : labels[instruction.operator];
+            prog->threaded[i].operand = instruction.operand;
+            prog->threaded[i].offset = instruction.offset;
+            prog->threaded[i].source = instruction.source;
+            prog->threaded[i].flags = instruction.flags;
+            prog->threaded[i].heat = 0;
+        }
+    }
+
+    // The state lives in locals while running, so that the compiler can keep it in registers
+    threaded_t *code = prog->threaded;
+    unsigned short *data = runtime->data;
+    unsigned int pc = runtime->pc;
+    long ptr = runtime->ptr;
+    bool guarded = runtime->guarded;
+    bool bounded = runtime->bounded;
+    unsigned int hot = runtime->hot;
+
+    unsigned long steps = 0;
+    int halt = HALT_NONE;
+    long cell;
+
+/// Whether or not the instruction at pc may skip its bounds checks (see runtime_exec)
+#define UNCHECKED() (bounded || ((code[pc].flags & IF_UNCHECKED) && guarded))
+/// Whether or not the cell at the given index is off the tape
+#define OFF_TAPE(index) ((index) < 0 || (index) >= DATA_SIZE)
+/// Jumps to the code of the instruction at pc unless the count of instructions has been executed
+#define DISPATCH() do { if (steps == count) goto done; steps++; goto *code[pc].label; } while (0)
+
+    DISPATCH();
+
+op_end:
+    halt = HALT_END;
+    goto done;
+op_inc:
+    if (!UNCHECKED() && OFF_TAPE(ptr + (long) code[pc].operand)) {
+        goto fault;
+    }
+    ptr += code[pc].operand;
+    pc++;
+    DISPATCH();
+op_dec:
+    if (!UNCHECKED() && OFF_TAPE(ptr - (long) code[pc].operand)) {
+        goto fault;
+    }
+    ptr -= code[pc].operand;
+    pc++;
+    DISPATCH();
+op_add:
+    cell = ptr + code[pc].offset;
+    if (!UNCHECKED() && OFF_TAPE(cell)) {
+        goto fault;
+    }
+    data[cell] += code[pc].operand;
+    pc++;
+    DISPATCH();
+op_sub:
+    cell = ptr + code[pc].offset;
+    if (!UNCHECKED() && OFF_TAPE(cell)) {
+        goto fault;
+    }
+    data[cell] -= code[pc].operand;
+    pc++;
+    DISPATCH();
+op_out:
+    cell = ptr + code[pc].offset;
+    if (!UNCHECKED() && OFF_TAPE(cell)) {
+        goto fault;
+    }
+    fputc(data[cell], runtime->output);
+    pc++;
+    DISPATCH();
+op_in:
+    cell = ptr + code[pc].offset;
+    if (!UNCHECKED() && OFF_TAPE(cell)) {
+        goto fault;
+    }
+    data[cell] = (unsigned int) getc(runtime->input);
+    pc++;
+    DISPATCH();
+op_jmp:
+    pc = data[ptr] ? pc + 1 : code[pc].operand + 1;
+    DISPATCH();
+op_ret:
+    if (data[ptr]) {
+        // Every loop that gets hot passes its end, the iteration is counted before the handover
+        if (hot && ++code[pc].heat >= hot) {
+            pc = code[pc].operand + 1;
+            goto tier_up;
+        }
+        pc = code[pc].operand + 1;
+    } else {
+        pc++;
+    }
+    // Every execution that does not end passes a loop's end, so the stop flag is only checked here
+    if (runtime->stop) {
+        goto interrupt;
+    }
+    DISPATCH();
+op_clear:
+    cell = ptr + code[pc].offset;
+    if (!UNCHECKED() && OFF_TAPE(cell)) {
+        goto fault;
+    }
+    data[cell] = 0;
+    pc++;
+    DISPATCH();
+op_set:
+    cell = ptr + code[pc].offset;
+    if (!UNCHECKED() && OFF_TAPE(cell)) {
+        goto fault;
+    }
+    data[cell] = code[pc].operand;
+    pc++;
+    DISPATCH();
+op_muladd:
+    if (data[ptr]) {
+        cell = ptr + code[pc].offset;
+        if (!UNCHECKED() && OFF_TAPE(cell)) {
+            goto fault;
+        }
+        data[cell] += (unsigned int) code[pc].operand * data[ptr];
+    }
+    pc++;
+    DISPATCH();
+op_mulmul:
+    cell = ptr + code[pc].offset;
+    if (!UNCHECKED() && (OFF_TAPE(cell) || OFF_TAPE(ptr + code[pc].source))) {
+        goto fault;
+    }
+    data[cell] += (unsigned int) code[pc].operand * data[ptr] * data[ptr + code[pc].source];
+    pc++;
+    DISPATCH();
+op_scan:
+    if (data[ptr]) {
+        cell = scan_tape(data, ptr + code[pc].offset, code[pc].offset);
+        if (cell < 0) {
+            goto fault;
+        }
+        ptr = cell;
+    }
+    pc++;
+    DISPATCH();
+op_move_jmp:
+    if (!UNCHECKED() && OFF_TAPE(ptr + code[pc].offset)) {
+        goto fault;
+    }
+    ptr += code[pc].offset;
+    pc = data[ptr] ? pc + 1 : code[pc].operand + 1;
+    DISPATCH();
+op_move_ret:
+    if (!UNCHECKED() && OFF_TAPE(ptr + code[pc].offset)) {
+        goto fault;
+    }
+    ptr += code[pc].offset;
+    if (data[ptr]) {
+        if (hot && ++code[pc].heat >= hot) {
+            pc = code[pc].operand + 1;
+            goto tier_up;
+        }
+        pc = code[pc].operand + 1;
+    } else {
+        pc++;
+    }
+    if (runtime->stop) {
+        goto interrupt;
+    }
+    DISPATCH();
+op_guard:
+    cell = ptr + code[pc].offset;
+    guarded = !OFF_TAPE(cell) && !OFF_TAPE(cell + (long) code[pc].operand);
+    pc++;
+    // The guard is stepped along with its loop
+    goto *code[pc].label;
+op_break:
+    // Stop before the instruction, unless the execution resumes from it
+    if (steps > 1) {
+        steps--;
+        halt = HALT_BREAK;
+        goto done;
+    }
+    goto *labels[prog->ir.instructions[pc].operator];
+
+#undef UNCHECKED
+#undef OFF_TAPE
+#undef DISPATCH
+
+fault:
+    // Let runtime_exec fail on the instruction, so that errors leave the runtime in exactly the same state
+    runtime->ptr = ptr;
+    runtime->pc = pc;
+    runtime->guarded = guarded;
+
+    if (executed) {
+        *executed = steps;
+    }
+
+    return runtime_exec(runtime, prog->ir.instructions[pc]);
+
+interrupt:
+    runtime->stop = 0;
+    halt = HALT_INTERRUPT;
+    goto done;
+
+tier_up:
+    halt = HALT_HOT;
+
+done:
+    runtime->ptr = ptr;
+    runtime->pc = pc;
+    runtime->guarded = guarded;
+
+    if (executed) {
+        *executed = steps;
+    }
+
+    return halt;
+}
+
+#else
+
+int runtime_run(runtime_t *runtime, program_t *prog, unsigned long count, unsigned long *executed) {
+    return runtime_interpret(runtime, prog, count, executed);
+}
+
+#endif
+
+int runtime_interpret(runtime_t *runtime, program_t *prog, unsigned long count, unsigned long *executed) {
+    unsigned long steps = 0;
+    int halt = HALT_NONE;
+
+    while (steps < count && halt == HALT_NONE) {
+        instruction_t instruction = prog->ir.instructions[runtime->pc];
+
+        if ((instruction.flags & IF_BREAK) && steps > 0) {
+            halt = HALT_BREAK;
+            break;
+        } else if (runtime->stop) {
+            runtime->stop = 0;
+            halt = HALT_INTERRUPT;
+            break;
+        }
+
+        halt = runtime_exec(runtime, instruction);
+
+        // The guard is stepped along with its loop
+        if (instruction.operator != OP_GUARD) {
+            steps++;
+        }
+    }
+
+    if (executed) {
+        *executed = steps;
+    }
+
+    return halt;
+}
+
+int runtime_move(runtime_t *runtime, int distance) {
+    int halt = runtime_check_offset(runtime, distance);
+
+    if (!halt) {
+        runtime->ptr += distance;
+    }
+
+    return halt;
+}
+
+int runtime_check_offset(runtime_t *runtime, int offset) {
+    long index = (long) runtime->ptr + offset;
+
+    // Stop at the last cell in the offset's direction, just like stepping one cell at a time would have
+    if (index >= DATA_SIZE) {
+        runtime->ptr = DATA_SIZE - 1;
+        return HALT_OVERFLOW;
+    } else if (index < 0) {
+        runtime->ptr = 0;
+        return HALT_UNDERFLOW;
+    }
+
+    return HALT_NONE;
+}
+
+bool engine_init(program_t *prog) {
+    (void) prog;
+
+    return true;
+}
+
+bool engine_native_init(program_t *prog) {
+    (void) prog;
+
+#ifdef JIT
+    // The native code is generated once a loop gets hot (see jit_run)
+    return true;
+#else
+    return false;
+#endif
+}
+
+int engine_interpreter_step(runtime_t *runtime, program_t *prog) {
+    return runtime_interpret(runtime, prog, 1, NULL);
+}
+
+int engine_interpreter_run(runtime_t *runtime, program_t *prog, unsigned long count) {
+    return runtime_interpret(runtime, prog, count, NULL);
+}
+
+int engine_threaded_step(runtime_t *runtime, program_t *prog) {
+    return runtime_run(runtime, prog, 1, NULL);
+}
+
+int engine_threaded_run(runtime_t *runtime, program_t *prog, unsigned long count) {
+    return runtime_run(runtime, prog, count, NULL);
+}
+
+int engine_native_run(runtime_t *runtime, program_t *prog, unsigned long count) {
+    return count == ULONG_MAX ? jit_run(runtime, prog) : runtime_run(runtime, prog, count, NULL);
+}
+
+void engine_read_state(runtime_t *runtime, engine_state_t *state) {
+    state->pc = runtime->pc;
+    state->ptr = runtime->ptr;
+    state->data = runtime->data;
+}
+
+void engine_write_state(runtime_t *runtime, const engine_state_t *state) {
+    if (state->pc != runtime->pc || state->ptr != runtime->ptr) {
+        runtime->guarded = false;
+        runtime->bounded = false;
+    }
+
+    runtime->pc = state->pc;
+    runtime->ptr = state->ptr;
+}
+
+void jit_free(jit_t *jit) {
+    if (!jit) {
+        return;
+    }
+
+#ifdef JIT
+    munmap(jit->code, jit->size);
+#endif
+
+    free(jit->offsets);
+    free(jit);
+}
+
+#ifdef JIT
+
+void jit_emit(jit_asm_t *a, const void *bytes, size_t count) {
+    if (a->size + count > a->capacity) {
+        a->capacity = a->capacity * 2 + count;
+        a->bytes = (unsigned char*) realloc(a->bytes, a->capacity);
+    }
+
+    memcpy(&a->bytes[a->size], bytes, count);
+    a->size += count;
+}
+
+void jit_emit32(jit_asm_t *a, int32_t value) {
+    jit_emit(a, &value, sizeof(value));
+}
+
+void jit_emit_target(jit_asm_t *a, unsigned int pc, bool fault) {
+    if (a->patch_count == a->patch_capacity) {
+        a->patch_capacity = a->patch_capacity ? a->patch_capacity * 2 : IR_CAPACITY;
+        a->patches = (jit_patch_t*) realloc(a->patches, sizeof(jit_patch_t) * a->patch_capacity);
+    }
+
+    a->patches[a->patch_count++] = (jit_patch_t) { .at = a->size, .pc = pc, .fault = fault };
+    jit_emit32(a, 0);
+}
+
+void jit_emit_cell(jit_asm_t *a, int reg, int offset) {
+    const unsigned char operand[] = { 0x84 | (reg << 3), 0x63 };
+    jit_emit(a, operand, sizeof(operand));
+    jit_emit32(a, offset * 2);
+}
+
+void jit_emit_exit(jit_asm_t *a, unsigned int pc, int halt) {
+    // mov esi, pc; mov eax, halt; jmp epilogue
+    jit_emit(a, "\xBE", 1);
+    jit_emit32(a, pc);
+    jit_emit(a, "\xB8", 1);
+    jit_emit32(a, halt);
+    jit_emit(a, "\xE9", 1);
+    jit_emit32(a, (int32_t) (a->epilogue - (a->size + 4)));
+}
+
+void jit_emit_check(jit_asm_t *a, unsigned int pc, long offset) {
+    // lea rcx, [r12 + offset]; cmp rcx, DATA_SIZE; jae fault (negative indices are huge when compared unsigned)
+    jit_emit(a, "\x49\x8D\x8C\x24", 4);
+    jit_emit32(a, (int32_t) offset);
+    jit_emit(a, "\x48\x81\xF9", 3);
+    jit_emit32(a, DATA_SIZE);
+    jit_emit(a, "\x0F\x83", 2);
+    jit_emit_target(a, pc, true);
+}
+
+void jit_emit_move(jit_asm_t *a, unsigned int pc, long distance, bool checked) {
+    if (checked) {
+        // mov r12, rcx
+        jit_emit_check(a, pc, distance);
+        jit_emit(a, "\x49\x89\xCC", 3);
+    } else {
+        // add r12, distance
+        jit_emit(a, "\x49\x81\xC4", 3);
+        jit_emit32(a, (int32_t) distance);
+    }
+}
+
+void jit_emit_test(jit_asm_t *a) {
+    // movzx eax, word [cell]; test eax, eax
+    jit_emit(a, "\x42\x0F\xB7", 3);
+    jit_emit_cell(a, 0, 0);
+    jit_emit(a, "\x85\xC0", 2);
+}
+
+void jit_emit_call(jit_asm_t *a, uintptr_t function) {
+    // mov rax, function; call rax
+    jit_emit(a, "\x48\xB8", 2);
+    jit_emit(a, &function, sizeof(function));
+    jit_emit(a, "\xFF\xD0", 2);
+}
+
+void jit_emit_loop_end(jit_asm_t *a, unsigned int start) {
+    jit_emit_test(a);
+
+    // Executables are not stopped by the debugger, jnz start
+    if (a->standalone) {
+        jit_emit(a, "\x0F\x85", 2);
+        jit_emit_target(a, start, false);
+        return;
+    }
+
+    // jz done
+    jit_emit(a, "\x74\x00", 2);
+    size_t done = a->size;
+
+    // cmp dword [r13 + stop], 0; je continue; exit; continue: jmp start
+    jit_emit(a, "\x41\x83\xBD", 3);
+    jit_emit32(a, offsetof(runtime_t, stop));
+    jit_emit(a, "\x00\x74\x00", 3);
+    size_t resume = a->size;
+    jit_emit_exit(a, start, HALT_INTERRUPT);
+    a->bytes[resume - 1] = (unsigned char) (a->size - resume);
+    jit_emit(a, "\xE9", 1);
+    jit_emit_target(a, start, false);
+
+    a->bytes[done - 1] = (unsigned char) (a->size - done);
+}
+
+void jit_emit_call_routine(jit_asm_t *a, size_t routine) {
+    jit_emit(a, "\xE8", 1);
+    jit_emit32(a, (int32_t) (routine - (a->size + 4)));
+}
+
+void jit_emit_exit_process(jit_asm_t *a, int status) {
+    // mov edi, status; mov eax, 60 (exit); syscall
+    jit_emit(a, "\xBF", 1);
+    jit_emit32(a, status);
+    jit_emit(a, "\xB8\x3C\x00\x00\x00\x0F\x05", 7);
+}
+
+void jit_emit_fail(jit_asm_t *a, const program_t *prog, unsigned int pc) {
+    span_t span = prog->ir.spans[pc];
+    char *location = NULL;
+    size_t length = 0;
+
+    FILE *fp = open_memstream(&location, &length);
+    fprintf(fp, "At instruction %d (%d:%d '", span.start + 1, span.line, span.col);
+    print_span(fp, prog, span);
+    fprintf(fp, "').\n");
+    fclose(fp);
+
+    // lea rsi, [rip + 10] (the location after the jump); mov edx, length; jmp fail
+    jit_emit(a, "\x48\x8D\x35\x0A\x00\x00\x00\xBA", 8);
+    jit_emit32(a, (int32_t) length);
+    jit_emit(a, "\xE9", 1);
+    jit_emit32(a, (int32_t) (a->fail - (a->size + 4)));
+    jit_emit(a, location, length);
+
+    free(location);
+}
+
+void jit_generate(jit_asm_t *a, const program_t *prog, bool checked) {
+    for (unsigned int pc = 0; pc < prog->ir.count; ++pc) {
+        instruction_t instruction = prog->ir.instructions[pc];
+        bool check = checked;
+
+        a->offsets[pc] = a->size;
+
+        if ((instruction.flags & IF_BREAK) && !a->standalone) {
+            jit_emit_exit(a, pc, HALT_BREAK);
+        }
+
+        switch (instruction.operator) {
+            case OP_END:
+                if (a->standalone) {
+                    jit_emit_call_routine(a, a->flush);
+                    jit_emit_exit_process(a, 0);
+                } else {
+                    jit_emit_exit(a, pc, HALT_END);
+                }
+                break;
+            case OP_INC:
+                jit_emit_move(a, pc, instruction.operand, check);
+                break;
+            case OP_DEC:
+                jit_emit_move(a, pc, -(long) instruction.operand, check);
+                break;
+            case OP_ADD:
+            case OP_SUB:
+                // add word [cell], operand or sub word [cell], operand
+                if (check) {
+                    jit_emit_check(a, pc, instruction.offset);
+                }
+                jit_emit(a, "\x66\x42\x81", 3);
+                jit_emit_cell(a, instruction.operator == OP_ADD ? 0 : 5, instruction.offset);
+                jit_emit(a, &instruction.operand, 2);
+                break;
+            case OP_CLEAR:
+            case OP_SET:
+                // mov word [cell], operand
+                if (check) {
+                    jit_emit_check(a, pc, instruction.offset);
+                }
+                if (instruction.operator == OP_CLEAR) {
+                    instruction.operand = 0;
+                }
+                jit_emit(a, "\x66\x42\xC7", 3);
+                jit_emit_cell(a, 0, instruction.offset);
+                jit_emit(a, &instruction.operand, 2);
+                break;
+            case OP_OUT:
+                if (check) {
+                    jit_emit_check(a, pc, instruction.offset);
+                }
+                if (a->standalone) {
+                    // movzx eax, word [cell]; mov [r15 + r14], al; inc r14; cmp r14, ELF_BUFFER; jne done; call flush
+                    jit_emit(a, "\x42\x0F\xB7", 3);
+                    jit_emit_cell(a, 0, instruction.offset);
+                    jit_emit(a, "\x43\x88\x04\x37\x49\xFF\xC6\x49\x81\xFE", 10);
+                    jit_emit32(a, ELF_BUFFER);
+                    jit_emit(a, "\x75\x05", 2);
+                    jit_emit_call_routine(a, a->flush);
+                    break;
+                }
+                // movzx edi, word [cell]; mov rsi, [r13 + output]; call fputc
+                jit_emit(a, "\x42\x0F\xB7", 3);
+                jit_emit_cell(a, 7, instruction.offset);
+                jit_emit(a, "\x49\x8B\xB5", 3);
+                jit_emit32(a, offsetof(runtime_t, output));
+                jit_emit_call(a, (uintptr_t) &fputc);
+                break;
+            case OP_IN:
+                if (check) {
+                    jit_emit_check(a, pc, instruction.offset);
+                }
+                if (a->standalone) {
+                    // The output is written first, e.g. for prompts. call flush; xor eax, eax (read); xor edi, edi;
+                    // lea rsi, [r15 + ELF_BUFFER]; mov edx, 1; syscall; mov edx, 0xFFFF (EOF, like getc's);
+                    // cmp rax, 1; jne eof; movzx edx, byte [r15 + ELF_BUFFER]; eof: mov word [cell], dx
+                    jit_emit_call_routine(a, a->flush);
+                    jit_emit(a, "\x31\xC0\x31\xFF\x49\x8D\xB7", 7);
+                    jit_emit32(a, ELF_BUFFER);
+                    jit_emit(a, "\xBA\x01\x00\x00\x00\x0F\x05\xBA\xFF\xFF\x00\x00\x48\x83\xF8\x01\x75\x08\x41\x0F\xB6\x97", 22);
+                    jit_emit32(a, ELF_BUFFER);
+                    jit_emit(a, "\x66\x42\x89", 3);
+                    jit_emit_cell(a, 2, instruction.offset);
+                    break;
+                }
+                // mov rdi, [r13 + input]; call getc; mov word [cell], ax
+                jit_emit(a, "\x49\x8B\xBD", 3);
+                jit_emit32(a, offsetof(runtime_t, input));
+                jit_emit_call(a, (uintptr_t) &getc);
+                jit_emit(a, "\x66\x42\x89", 3);
+                jit_emit_cell(a, 0, instruction.offset);
+                break;
+            case OP_MOVE_JMP:
+                jit_emit_move(a, pc, instruction.offset, check);
+                // fall through
+            case OP_JMP:
+                // jz after the loop's end
+                jit_emit_test(a);
+                jit_emit(a, "\x0F\x84", 2);
+                jit_emit_target(a, instruction.operand + 1, false);
+                break;
+            case OP_MOVE_RET:
+                jit_emit_move(a, pc, instruction.offset, check);
+                // fall through
+            case OP_RET:
+                jit_emit_loop_end(a, instruction.operand + 1);
+                break;
+            case OP_MULADD: {
+                // The cell is only accessed if the loop's cell is not zero
+                jit_emit_test(a);
+                jit_emit(a, "\x74\x00", 2);
+                size_t skip = a->size;
+                if (check) {
+                    jit_emit_check(a, pc, instruction.offset);
+                }
+                // imul eax, eax, operand; add word [cell], ax
+                jit_emit(a, "\x69\xC0", 2);
+                jit_emit32(a, instruction.operand);
+                jit_emit(a, "\x66\x42\x01", 3);
+                jit_emit_cell(a, 0, instruction.offset);
+                a->bytes[skip - 1] = (unsigned char) (a->size - skip);
+                break;
+            }
+            case OP_MULMUL:
+                if (check) {
+                    jit_emit_check(a, pc, instruction.offset);
+                    jit_emit_check(a, pc, instruction.source);
+                }
+                // movzx eax, word [ptr]; movzx edx, word [source]; imul eax, edx; imul eax, eax, operand;
+                // add word [cell], ax
+                jit_emit(a, "\x42\x0F\xB7", 3);
+                jit_emit_cell(a, 0, 0);
+                jit_emit(a, "\x42\x0F\xB7", 3);
+                jit_emit_cell(a, 2, instruction.source);
+                jit_emit(a, "\x0F\xAF\xC2\x69\xC0", 5);
+                jit_emit32(a, instruction.operand);
+                jit_emit(a, "\x66\x42\x01", 3);
+                jit_emit_cell(a, 0, instruction.offset);
+                break;
+            case OP_SCAN: {
+                // The scan starts at the next cell, so it is skipped if the current cell is already zero
+                jit_emit_test(a);
+                jit_emit(a, "\x74\x00", 2);
+                size_t skip = a->size;
+                if (a->standalone) {
+                    // lea rcx, [r12 + offset]; loop: cmp rcx, DATA_SIZE; jae fault; cmp word [rbx + rcx * 2], 0;
+                    // je found; add rcx, offset; jmp loop; found: mov r12, rcx
+                    jit_emit(a, "\x49\x8D\x8C\x24", 4);
+                    jit_emit32(a, instruction.offset);
+                    size_t loop = a->size;
+                    jit_emit(a, "\x48\x81\xF9", 3);
+                    jit_emit32(a, DATA_SIZE);
+                    jit_emit(a, "\x0F\x83", 2);
+                    jit_emit_target(a, pc, true);
+                    jit_emit(a, "\x66\x83\x3C\x4B\x00\x74\x09\x48\x81\xC1", 10);
+                    jit_emit32(a, instruction.offset);
+                    jit_emit(a, "\xEB", 1);
+                    jit_emit(a, &(signed char) { (signed char) (loop - (a->size + 1)) }, 1);
+                    jit_emit(a, "\x49\x89\xCC", 3);
+                    a->bytes[skip - 1] = (unsigned char) (a->size - skip);
+                    break;
+                }
+                // mov rdi, rbx; lea rsi, [r12 + offset]; mov edx, offset; call scan_tape
+                jit_emit(a, "\x48\x89\xDF\x49\x8D\xB4\x24", 7);
+                jit_emit32(a, instruction.offset);
+                jit_emit(a, "\xBA", 1);
+                jit_emit32(a, instruction.offset);
+                jit_emit_call(a, (uintptr_t) &scan_tape);
+                // test rax, rax; js fault; mov r12, rax
+                jit_emit(a, "\x48\x85\xC0\x0F\x88", 5);
+                jit_emit_target(a, pc, true);
+                jit_emit(a, "\x49\x89\xC4", 3);
+                a->bytes[skip - 1] = (unsigned char) (a->size - skip);
+                break;
+            }
+            case OP_GUARD:
+                // Every access is checked on its own unless the whole program is proven to stay on the tape
+                break;
+        }
+    }
+
+    // The fault exits are out of line, so that the checks do not jump in the common case
+    for (unsigned int i = 0; i < a->patch_count; ++i) {
+        unsigned int pc = a->patches[i].pc;
+
+        if (a->patches[i].fault && !a->faults[pc]) {
+            a->faults[pc] = a->size;
+
+            if (a->standalone) {
+                jit_emit_fail(a, prog, pc);
+            } else {
+                jit_emit_exit(a, pc, JIT_FAULT);
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < a->patch_count; ++i) {
+        size_t target = a->patches[i].fault ? a->faults[a->patches[i].pc] : a->offsets[a->patches[i].pc];
+        int32_t displacement = (int32_t) (target - (a->patches[i].at + 4));
+        memcpy(&a->bytes[a->patches[i].at], &displacement, sizeof(displacement));
+    }
+
+    free(a->patches);
+    free(a->faults);
+}
+
+jit_t *jit_compile(const program_t *prog, bool checked) {
+    jit_asm_t a = {
+        .bytes = NULL, .size = 0, .capacity = 0, .standalone = false, .epilogue = 0, .patches = NULL, .patch_count = 0,
+        .patch_capacity = 0, .offsets = (size_t*) calloc(prog->ir.count, sizeof(size_t)),
+        .faults = (size_t*) calloc(prog->ir.count, sizeof(size_t))
+    };
+
+    // push rbp; push rbx; push r12; push r13; push r14 (which also aligns the stack for calls)
+    jit_emit(&a, "\x55\x53\x41\x54\x41\x55\x41\x56", 8);
+    // mov r13, rdi; lea rbx, [rdi + data]; mov r12d, [rdi + ptr]; jmp rsi
+    jit_emit(&a, "\x49\x89\xFD\x48\x8D\x9F", 6);
+    jit_emit32(&a, offsetof(runtime_t, data));
+    jit_emit(&a, "\x44\x8B\xA7", 3);
+    jit_emit32(&a, offsetof(runtime_t, ptr));
+    jit_emit(&a, "\xFF\xE6", 2);
+
+    // mov [r13 + ptr], r12d; mov [r13 + pc], esi; pop r14; pop r13; pop r12; pop rbx; pop rbp; ret
+    a.epilogue = a.size;
+    jit_emit(&a, "\x45\x89\xA5", 3);
+    jit_emit32(&a, offsetof(runtime_t, ptr));
+    jit_emit(&a, "\x41\x89\xB5", 3);
+    jit_emit32(&a, offsetof(runtime_t, pc));
+    jit_emit(&a, "\x41\x5E\x41\x5D\x41\x5C\x5B\x5D\xC3", 9);
+
+    jit_generate(&a, prog, checked);
+
+    // The code is only made executable once it is complete and never is writable and executable at the same time
+    void *code = mmap(NULL, a.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (code == MAP_FAILED) {
+        free(a.bytes);
+        free(a.offsets);
+        return NULL;
+    }
+
+    memcpy(code, a.bytes, a.size);
+    free(a.bytes);
+
+    // Policies that deny executable mappings leave the program to the threaded engine
+    if (mprotect(code, a.size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, a.size);
+        free(a.offsets);
+        return NULL;
+    }
+
+    jit_t *jit = (jit_t*) malloc(sizeof(jit_t));
+    jit->code = (unsigned char*) code;
+    jit->size = a.size;
+    jit->offsets = a.offsets;
+    jit->checked = checked;
+
+    return jit;
+}
+
+#endif
+
+bool emit_elf(FILE *fp, const program_t *prog) {
+#ifdef JIT
+    /// The address the executable is loaded at
+    const uint64_t base = 0x400000;
+    /// The address of the tape, followed by the output buffer and the byte read by ','
+    const uint64_t tape = 0x10000000;
+    /// The size of the headers, which are loaded together with the code
+    const size_t headers = sizeof(Elf64_Ehdr) + 2 * sizeof(Elf64_Phdr);
+
+    jit_asm_t a = {
+        .bytes = NULL, .size = 0, .capacity = 0, .standalone = true, .epilogue = 0, .patches = NULL, .patch_count = 0,
+        .patch_capacity = 0, .offsets = (size_t*) calloc(prog->ir.count, sizeof(size_t)),
+        .faults = (size_t*) calloc(prog->ir.count, sizeof(size_t))
+    };
+
+    // mov rbx, tape; mov r15, output; mov r12d, init_ptr; xor r14d, r14d (the count of buffered bytes)
+    jit_emit(&a, "\x48\xBB", 2);
+    jit_emit(&a, &tape, sizeof(tape));
+    jit_emit(&a, "\x49\xBF", 2);
+    jit_emit(&a, &(uint64_t) { tape + DATA_SIZE * sizeof(unsigned short) }, sizeof(uint64_t));
+    jit_emit(&a, "\x41\xBC", 2);
+    jit_emit32(&a, prog->init_ptr);
+    jit_emit(&a, "\x45\x31\xF6", 3);
+
+    // Start from the state the input-independent prefix of the program left behind, mov word [rbx + index * 2], value
+    for (unsigned int i = 0; i < DATA_SIZE; ++i) {
+        if (prog->init_data[i]) {
+            jit_emit(&a, "\x66\xC7\x83", 3);
+            jit_emit32(&a, i * 2);
+            jit_emit(&a, &prog->init_data[i], 2);
+        }
+    }
+
+    jit_emit(&a, "\xE9", 1);
+    jit_emit_target(&a, prog->init_pc, false);
+
+    // flush: test r14, r14; jz done; mov rsi, r15; mov rdx, r14; loop: mov edi, 1; mov eax, 1 (write); syscall;
+    // test rax, rax; jle done; add rsi, rax; sub rdx, rax; jnz loop; done: xor r14d, r14d; ret
+    a.flush = a.size;
+    jit_emit(&a, "\x4D\x85\xF6\x74\x1F\x4C\x89\xFE\x4C\x89\xF2\xBF\x01\x00\x00\x00\xB8\x01\x00\x00\x00\x0F\x05\x48\x85"
+                 "\xC0\x7E\x08\x48\x01\xC6\x48\x29\xC2\x75\xE7\x45\x31\xF6\xC3", 40);
+
+    // The messages are the ones of dbg_runtime_error
+    char overflow[128];
+    const char underflow[] = "\n\x1B[31mRuntime error\x1B[0m: trying to decrement the data pointer below 0.\n";
+    const char exited[] = "Brainfuck exited with \x1B[31merror\x1B[0m.\n";
+    snprintf(overflow, sizeof(overflow),
+             "\n\x1B[31mRuntime error\x1B[0m: trying to increment the data pointer out of range (%d).\n", DATA_SIZE);
+
+    // fail: push rdx; push rsi; push rcx (the location and the cell); call flush; pop rcx;
+    // lea rsi, [rip + overflow]; mov edx, length; test rcx, rcx; jns write; lea rsi, [rip + underflow]; mov edx, length
+    a.fail = a.size;
+    jit_emit(&a, "\x52\x56\x51", 3);
+    jit_emit_call_routine(&a, a.flush);
+    jit_emit(&a, "\x59\x48\x8D\x35", 4);
+    size_t overflow_at = a.size;
+    jit_emit32(&a, 0);
+    jit_emit(&a, "\xBA", 1);
+    jit_emit32(&a, (int32_t) strlen(overflow));
+    jit_emit(&a, "\x48\x85\xC9\x79\x0C\x48\x8D\x35", 8);
+    size_t underflow_at = a.size;
+    jit_emit32(&a, 0);
+    jit_emit(&a, "\xBA", 1);
+    jit_emit32(&a, (int32_t) strlen(underflow));
+    // write: mov edi, 2; mov eax, 1; syscall; pop rsi; pop rdx; mov edi, 2; mov eax, 1; syscall;
+    // lea rsi, [rip + exited]; mov edx, length; mov edi, 1; mov eax, 1; syscall
+    jit_emit(&a, "\xBF\x02\x00\x00\x00\xB8\x01\x00\x00\x00\x0F\x05\x5E\x5A\xBF\x02\x00\x00\x00\xB8\x01\x00\x00\x00\x0F"
+                 "\x05\x48\x8D\x35", 29);
+    size_t exited_at = a.size;
+    jit_emit32(&a, 0);
+    jit_emit(&a, "\xBA", 1);
+    jit_emit32(&a, (int32_t) strlen(exited));
+    jit_emit(&a, "\xBF\x01\x00\x00\x00\xB8\x01\x00\x00\x00\x0F\x05", 12);
+    jit_emit_exit_process(&a, EXIT_FAILURE);
+
+    const char *messages[] = { overflow, underflow, exited };
+    size_t references[] = { overflow_at, underflow_at, exited_at };
+    for (int i = 0; i < 3; ++i) {
+        int32_t displacement = (int32_t) (a.size - (references[i] + 4));
+        memcpy(&a.bytes[references[i]], &displacement, sizeof(displacement));
+        jit_emit(&a, messages[i], strlen(messages[i]));
+    }
+
+    // Nothing can move the data pointer behind the program's back, so the analysis alone decides about the checks
+    jit_generate(&a, prog, prog->bounds != BOUNDS_PROVEN);
+
+    Elf64_Ehdr header = {
+        .e_ident = { ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS64, ELFDATA2LSB, EV_CURRENT, ELFOSABI_SYSV },
+        .e_type = ET_EXEC, .e_machine = EM_X86_64, .e_version = EV_CURRENT, .e_entry = base + headers,
+        .e_phoff = sizeof(Elf64_Ehdr), .e_shoff = 0, .e_flags = 0, .e_ehsize = sizeof(Elf64_Ehdr),
+        .e_phentsize = sizeof(Elf64_Phdr), .e_phnum = 2, .e_shentsize = 0, .e_shnum = 0, .e_shstrndx = SHN_UNDEF
+    };
+    Elf64_Phdr segments[] = {
+        // The headers and the code
+        { .p_type = PT_LOAD, .p_flags = PF_R | PF_X, .p_offset = 0, .p_vaddr = base, .p_paddr = base,
+          .p_filesz = headers + a.size, .p_memsz = headers + a.size, .p_align = 0x1000 },
+        // The tape, the output buffer and the input byte, which the kernel zeroes
+        { .p_type = PT_LOAD, .p_flags = PF_R | PF_W, .p_offset = 0, .p_vaddr = tape, .p_paddr = tape,
+          .p_filesz = 0, .p_memsz = DATA_SIZE * sizeof(unsigned short) + ELF_BUFFER + 1, .p_align = 0x1000 }
+    };
+
+    bool written = fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(segments, sizeof(segments), 1, fp) == 1 &&
+                   fwrite(a.bytes, 1, a.size, fp) == a.size;
+
+    free(a.bytes);
+    free(a.offsets);
+
+    return written;
+#else
+    (void) fp;
+    (void) prog;
+
+    return false;
+#endif
+}
+
+int jit_run(runtime_t *runtime, program_t *prog) {
+#ifdef JIT
+    if (!prog->jit) {
+        // Short runs are over before the native code would pay off, so the threaded engine runs until a loop gets hot
+        runtime->hot = JIT_THRESHOLD;
+        int halt = runtime_run(runtime, prog, ULONG_MAX, NULL);
+        runtime->hot = 0;
+
+        if (halt != HALT_HOT) {
+            return halt;
+        }
+    } else if (prog->ir.instructions[runtime->pc].flags & IF_BREAK) {
+        // Execution resumes from a breakpoint, so it is stepped over before entering the native code
+        int halt = runtime_run(runtime, prog, 1, NULL);
+        if (halt != HALT_NONE) {
+            return halt;
+        }
+    }
+
+    // The checks can only be left out as long as the data pointer has not been moved by the debugger
+    bool checked = !runtime->bounded;
+    if (prog->jit && prog->jit->checked != checked) {
+        jit_free(prog->jit);
+        prog->jit = NULL;
+    }
+
+    if (!prog->jit) {
+        prog->jit = jit_compile(prog, checked);
+    }
+
+    if (prog->jit) {
+        jit_entry_t entry = (jit_entry_t) prog->jit->code;
+        int halt = entry(runtime, prog->jit->code + prog->jit->offsets[runtime->pc]);
+
+        // The native code does not track the guards
+        runtime->guarded = false;
+
+        if (halt == HALT_INTERRUPT) {
+            runtime->stop = 0;
+        } else if (halt == JIT_FAULT) {
+            // Let runtime_exec fail on the instruction, so that errors leave the runtime in exactly the same state
+            halt = runtime_exec(runtime, prog->ir.instructions[runtime->pc]);
+        }
+
+        return halt;
+    }
+#endif
+
+    return runtime_run(runtime, prog, ULONG_MAX, NULL);
+}
+
+void emit_c(FILE *fp, const program_t *prog, const char *name) {
+    const ir_t *ir = &prog->ir;
+
+    /// Whether or not the instruction is jumped to and needs a label
+    bool *targets = (bool*) calloc(ir->count, sizeof(bool));
+    /// Whether or not the program needs the bounds checks, the guards and the scan
+    bool checked = prog->bounds != BOUNDS_PROVEN, guards = false, scans = false;
+
+    // The instructions before the initial one already ran ahead of time (see evaluate_prefix)
+    targets[prog->init_pc] = prog->init_pc > 0;
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        switch (ir->instructions[pc].operator) {
+            case OP_JMP:
+            case OP_RET:
+            case OP_MOVE_JMP:
+            case OP_MOVE_RET:
+                targets[ir->instructions[pc].operand + 1] = true;
+                break;
+            case OP_GUARD:
+                guards = checked;
+                break;
+            case OP_SCAN:
+                scans = true;
+                break;
+        }
+    }
+
+    fprintf(fp, "// Generated by %s from %s, build it with e.g. 'gcc -O2'\n", TAG, name);
+    fprintf(fp, "#include <stdio.h>\n#include <stdlib.h>\n\n");
+    fprintf(fp, "#define DATA_SIZE %d\n", DATA_SIZE);
+    fprintf(fp, "#define OFF_TAPE(index) ((index) < 0 || (index) >= DATA_SIZE)\n\n");
+    fprintf(fp, "static unsigned short data[DATA_SIZE];\nstatic long ptr;\n\n");
+
+    // The error messages are the ones of dbg_runtime_error
+    if (checked || scans) {
+        fprintf(fp, "static void fail(long index, int start, int line, int col, const char *span) {\n");
+        fprintf(fp, "    if (index >= DATA_SIZE) {\n");
+        fprintf(fp, "        ptr = DATA_SIZE - 1;\n");
+        fprintf(fp, "        fprintf(stderr, \"\\n\\x1B[31mRuntime error\\x1B[0m: trying to increment the data pointer out of range (%%d).\\n\", DATA_SIZE);\n");
+        fprintf(fp, "    } else {\n");
+        fprintf(fp, "        ptr = 0;\n");
+        fprintf(fp, "        fprintf(stderr, \"\\n\\x1B[31mRuntime error\\x1B[0m: trying to decrement the data pointer below 0.\\n\");\n");
+        fprintf(fp, "    }\n");
+        fprintf(fp, "    fprintf(stderr, \"At instruction %%d (%%d:%%d '%%s'). $[$ptr: %%ld]: %%d.\\n\", start, line, col, span, ptr, data[ptr]);\n");
+        fprintf(fp, "    fprintf(stdout, \"Brainfuck exited with \\x1B[31merror\\x1B[0m.\\n\");\n");
+        fprintf(fp, "    exit(EXIT_FAILURE);\n");
+        fprintf(fp, "}\n\n");
+    }
+
+    if (scans) {
+        fprintf(fp, "static long scan(long index, int stride) {\n");
+        fprintf(fp, "    while (index >= 0 && index < DATA_SIZE) {\n");
+        fprintf(fp, "        if (!data[index]) {\n");
+        fprintf(fp, "            return index;\n");
+        fprintf(fp, "        }\n");
+        fprintf(fp, "        index += stride;\n");
+        fprintf(fp, "    }\n");
+        fprintf(fp, "    return -1;\n");
+        fprintf(fp, "}\n\n");
+    }
+
+    fprintf(fp, "int main(void) {\n");
+    if (guards) {
+        fprintf(fp, "    int guarded = 0;\n");
+    }
+
+    // Start from the state the input-independent prefix of the program left behind
+    for (unsigned int i = 0; i < DATA_SIZE; ++i) {
+        if (prog->init_data[i]) {
+            fprintf(fp, "    data[%u] = %u;\n", i, prog->init_data[i]);
+        }
+    }
+    fprintf(fp, "    ptr = %u;\n", prog->init_ptr);
+    if (prog->init_pc > 0) {
+        fprintf(fp, "    goto l%u;\n", prog->init_pc);
+    }
+    fprintf(fp, "\n");
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t instruction = ir->instructions[pc];
+        /// Whether or not the instruction checks the cells it accesses
+        bool check = checked && instruction.operator != OP_GUARD;
+        /// Whether or not the guard of the instruction's loop may already have checked the cells it accesses
+        bool guarded = guards && (instruction.flags & IF_UNCHECKED);
+
+        if (targets[pc]) {
+            fprintf(fp, "l%u:\n", pc);
+        }
+
+        fprintf(fp, "    // ");
+        print_span(fp, prog, ir->spans[pc]);
+        fprintf(fp, "\n");
+
+        switch (instruction.operator) {
+            case OP_INC:
+            case OP_DEC:
+            case OP_MOVE_JMP:
+            case OP_MOVE_RET: {
+                int distance = instruction.operator == OP_INC ? (int) instruction.operand
+                             : instruction.operator == OP_DEC ? -(int) instruction.operand : instruction.offset;
+                if (check) {
+                    emit_c_check(fp, prog, pc, distance, guarded);
+                }
+                break;
+            }
+            case OP_ADD:
+            case OP_SUB:
+            case OP_OUT:
+            case OP_IN:
+            case OP_CLEAR:
+            case OP_SET:
+                if (check) {
+                    emit_c_check(fp, prog, pc, instruction.offset, guarded);
+                }
+                break;
+            case OP_MULMUL:
+                if (check) {
+                    emit_c_check(fp, prog, pc, instruction.offset, guarded);
+                    emit_c_check(fp, prog, pc, instruction.source, guarded);
+                }
+                break;
+        }
+
+        switch (instruction.operator) {
+            case OP_END:
+                fprintf(fp, "    return EXIT_SUCCESS;\n");
+                break;
+            case OP_INC:
+                fprintf(fp, "    ptr += %u;\n", instruction.operand);
+                break;
+            case OP_DEC:
+                fprintf(fp, "    ptr -= %u;\n", instruction.operand);
+                break;
+            case OP_ADD:
+            case OP_SUB:
+            case OP_SET:
+            case OP_CLEAR:
+                fprintf(fp, "    data[");
+                emit_c_cell(fp, instruction.offset);
+                fprintf(fp, "] %s %uu;\n", instruction.operator == OP_ADD ? "+=" : instruction.operator == OP_SUB ? "-=" : "=",
+                        instruction.operator == OP_CLEAR ? 0 : instruction.operand);
+                break;
+            case OP_OUT:
+                fprintf(fp, "    putchar(data[");
+                emit_c_cell(fp, instruction.offset);
+                fprintf(fp, "]);\n");
+                break;
+            case OP_IN:
+                fprintf(fp, "    data[");
+                emit_c_cell(fp, instruction.offset);
+                fprintf(fp, "] = (unsigned int) getchar();\n");
+                break;
+            case OP_MOVE_JMP:
+            case OP_MOVE_RET:
+                fprintf(fp, "    ptr += %d;\n", instruction.offset);
+                // fall through
+            case OP_JMP:
+            case OP_RET:
+                fprintf(fp, "    if (%sdata[ptr]) goto l%u;\n",
+                        instruction.operator == OP_JMP || instruction.operator == OP_MOVE_JMP ? "!" : "", instruction.operand + 1);
+                break;
+            case OP_MULADD:
+                // The loop would not have been entered for an empty cell, so neither are its bounds checked
+                fprintf(fp, "    if (data[ptr]) {\n");
+                if (check) {
+                    fprintf(fp, "    ");
+                    emit_c_check(fp, prog, pc, instruction.offset, guarded);
+                }
+                fprintf(fp, "        data[");
+                emit_c_cell(fp, instruction.offset);
+                fprintf(fp, "] += %uu * data[ptr];\n    }\n", instruction.operand);
+                break;
+            case OP_MULMUL:
+                fprintf(fp, "    data[");
+                emit_c_cell(fp, instruction.offset);
+                fprintf(fp, "] += %uu * data[ptr] * data[", instruction.operand);
+                emit_c_cell(fp, instruction.source);
+                fprintf(fp, "];\n");
+                break;
+            case OP_SCAN: {
+                span_t span = ir->spans[pc];
+                // Stop at the last cell in the scan's direction, just like stepping one cell at a time would have
+                fprintf(fp, "    if (data[ptr]) {\n");
+                fprintf(fp, "        long found = scan(");
+                emit_c_cell(fp, instruction.offset);
+                fprintf(fp, ", %d);\n", instruction.offset);
+                fprintf(fp, "        if (found < 0) fail(%s, %u, %d, %d, \"", instruction.offset > 0 ? "DATA_SIZE" : "-1",
+                        span.start + 1, span.line, span.col);
+                print_span(fp, prog, span);
+                fprintf(fp, "\");\n        ptr = found;\n    }\n");
+                break;
+            }
+            case OP_GUARD:
+                if (guards) {
+                    fprintf(fp, "    guarded = !OFF_TAPE(");
+                    emit_c_cell(fp, instruction.offset);
+                    fprintf(fp, ") && !OFF_TAPE(");
+                    emit_c_cell(fp, instruction.offset + (int) instruction.operand);
+                    fprintf(fp, ");\n");
+                }
+                break;
+        }
+    }
+
+    fprintf(fp, "}\n");
+
+    free(targets);
+}
+
+void emit_c_cell(FILE *fp, int offset) {
+    if (offset > 0) {
+        fprintf(fp, "ptr + %d", offset);
+    } else if (offset < 0) {
+        fprintf(fp, "ptr - %d", -offset);
+    } else {
+        fprintf(fp, "ptr");
+    }
+}
+
+void emit_c_check(FILE *fp, const program_t *prog, unsigned int pc, int offset, bool guarded) {
+    span_t span = prog->ir.spans[pc];
+
+    fprintf(fp, "    if (%sOFF_TAPE(", guarded ? "!guarded && " : "");
+    emit_c_cell(fp, offset);
+    fprintf(fp, ")) fail(");
+    emit_c_cell(fp, offset);
+    fprintf(fp, ", %u, %d, %d, \"", span.start + 1, span.line, span.col);
+    print_span(fp, prog, span);
+    fprintf(fp, "\");\n");
+}
+
+bool compile(FILE *fp, program_t *prog) {
+    size_t size;
+    char *source = read_source(fp, &size);
+    bool compiled = compile_source(source, size, prog);
+    free(source);
+
+    return compiled;
+}
+
+bool compile_source(const char *source, size_t size, program_t *prog) {
+    // Make sure that a program structure is provided
+    if (!prog) {
+        return false;
+    }
+
+    /// The current line in the file
+    int line = 1;
+    /// The current column in the file
+    int col = 1;
+
+    /// The count of loops that are currently open
+    unsigned int depth = 0;
+
+    /// The count of brainfuck instructions that fit into the code buffer
+    unsigned int code_capacity = 0;
+
+    program_free(prog);
+
+    for (size_t i = 0; i < size; ++i) {
+        char c = source[i];
+        instruction_t instruction = { .operator = OP_END, .operand = 0, .offset = 0 };
+
+        /// Whether or not the character is a brainfuck instruction
+        bool command = true;
+
+        switch (c) {
+            case '>':
+                instruction.operator = OP_INC;
+                instruction.operand = 1;
+                break;
+            case '<':
+                instruction.operator = OP_DEC;
+                instruction.operand = 1;
+                break;
+            case '+':
+                instruction.operator = OP_ADD;
+                instruction.operand = 1;
+                break;
+            case '-':
+                instruction.operator = OP_SUB;
+                instruction.operand = 1;
+                break;
+            case '.':
+                instruction.operator = OP_OUT;
+                break;
+            case ',':
+                instruction.operator = OP_IN;
+                break;
+            case '[':
+                instruction.operator = OP_JMP;
+                if (depth == STACK_SIZE) {
+                    compile_error(line, col, "loop count exceeds bfdb's capacity (%d).\n", STACK_SIZE);
+                    return false;
+                }
+                depth++;
+                break;
+            case ']':
+                if (depth == 0) {
+                    compile_error(line, col, "unmatched ']'.\n");
+                    return false;
+                }
+                instruction.operator = OP_RET;
+                depth--;
+                break;
+            default:
+                command = false;
+                break;
+        }
+
+        if (command) {
+            span_t span = { .line = line, .col = col, .start = prog->code_len, .end = prog->code_len + 1 };
+            ir_emit(&prog->ir, instruction, span);
+
+            if (prog->code_len == code_capacity) {
+                code_capacity = code_capacity ? code_capacity * 2 : IR_CAPACITY;
+                prog->code = (char*) realloc(prog->code, code_capacity);
+            }
+            prog->code[prog->code_len++] = c;
+        }
+
+        if (c == '\n') {
+            col = 1;
+            line++;
+        } else {
+            col++;
+        }
+    }
+
+    if (depth != 0) {
+        return false;
+    }
+
+    instruction_t end = { .operator = OP_END, .operand = 0, .offset = 0 };
+    span_t span = { .line = line, .col = col, .start = prog->code_len, .end = prog->code_len };
+    ir_emit(&prog->ir, end, span);
+
+    link_jumps(&prog->ir);
+
+    // Unless the prefix is evaluated, the program starts on an empty tape
+    memset(prog->init_data, 0, sizeof(unsigned short) * DATA_SIZE);
+    prog->init_ptr = 0;
+    prog->init_pc = 0;
+    prog->prefix_steps = 0;
+
+    // Unless the data pointer is analyzed, every access is checked
+    prog->bounds = BOUNDS_UNANALYZED;
+    prog->bounds_pc = 0;
+
+    return run_passes(prog);
+}
+
+char *read_source(FILE *fp, size_t *size) {
+    char *source = NULL;
+    size_t capacity = 0;
+    *size = 0;
+
+    do {
+        if (*size == capacity) {
+            capacity = capacity ? capacity * 2 : BUFSIZ;
+            source = (char*) realloc(source, capacity);
+        }
+        *size += fread(&source[*size], 1, capacity - *size, fp);
+    } while (*size == capacity);
+
+    return source;
+}
+
+void program_free(program_t *prog) {
+    ir_free(&prog->ir);
+    free(prog->threaded);
+    prog->threaded = NULL;
+    jit_free(prog->jit);
+    prog->jit = NULL;
+    free(prog->code);
+    prog->code = NULL;
+    prog->code_len = 0;
+}
+
+void compile_error(int line, int col, const char *fmt, ...) {
+    fprintf(stderr, "%d:%d: \x1B[31mcompilation error\x1B[0m: ", line, col);
+
+    va_list vl;
+    va_start(vl, fmt);
+    vfprintf(stderr, fmt, vl);
+    va_end(vl);
+
+    fprintf(stdout, "Compilation exited with \x1B[31merror\x1B[0m.\n");
+}
+
+span_t span_merge(span_t a, span_t b) {
+    span_t merged = a.start <= b.start ? a : b;
+    merged.end = a.end > b.end ? a.end : b.end;
+
+    return merged;
+}
+
+unsigned int program_find(const program_t *prog, unsigned int index) {
+    // The spans are in source order, so the first one ending after the instruction contains it (EOF has an empty span)
+    unsigned int pc = 0;
+    while (pc + 1 < prog->ir.count && prog->ir.spans[pc].end < index) {
+        pc++;
+    }
+
+    return pc;
+}
+
+void print_span(FILE *fp, const program_t *prog, span_t span) {
+    if (span.start == span.end) {
+        fputs(INSTRUCTIONS[OP_END], fp);
+    } else if (span.end - span.start > SPAN_PREVIEW) {
+        fprintf(fp, "%.*s...", SPAN_PREVIEW - 3, &prog->code[span.start]);
+    } else {
+        fprintf(fp, "%.*s", span.end - span.start, &prog->code[span.start]);
+    }
+}
+
+void print_cell(FILE *fp, int offset) {
+    if (offset == 0) {
+        fputs("$[$ptr]", fp);
+    } else {
+        fprintf(fp, "$[$ptr%+d]", offset);
+    }
+}
+
+void print_instruction(FILE *fp, instruction_t instruction) {
+    switch (instruction.operator) {
+        case OP_INC:
+            fprintf(fp, "$ptr += %d", instruction.operand);
+            break;
+        case OP_DEC:
+            fprintf(fp, "$ptr -= %d", instruction.operand);
+            break;
+        case OP_ADD:
+            print_cell(fp, instruction.offset);
+            fprintf(fp, " += %d", instruction.operand);
+            break;
+        case OP_SUB:
+            print_cell(fp, instruction.offset);
+            fprintf(fp, " -= %d", instruction.operand);
+            break;
+        case OP_OUT:
+            fputs("putchar(", fp);
+            print_cell(fp, instruction.offset);
+            fputc(')', fp);
+            break;
+        case OP_IN:
+            print_cell(fp, instruction.offset);
+            fputs(" = getchar()", fp);
+            break;
+        case OP_JMP:
+            fputs("enter loop if $[$ptr] != 0", fp);
+            break;
+        case OP_RET:
+            fputs("repeat loop if $[$ptr] != 0", fp);
+            break;
+        case OP_MOVE_JMP:
+            fprintf(fp, "$ptr %s= %d, enter loop if $[$ptr] != 0", instruction.offset > 0 ? "+" : "-", abs(instruction.offset));
+            break;
+        case OP_MOVE_RET:
+            fprintf(fp, "$ptr %s= %d, repeat loop if $[$ptr] != 0", instruction.offset > 0 ? "+" : "-", abs(instruction.offset));
+            break;
+        case OP_CLEAR:
+            print_cell(fp, instruction.offset);
+            fputs(" = 0", fp);
+            break;
+        case OP_SET:
+            print_cell(fp, instruction.offset);
+            fprintf(fp, " = %d", instruction.operand);
+            break;
+        case OP_MULADD:
+            print_cell(fp, instruction.offset);
+            fprintf(fp, " += %d * $[$ptr]", (short) instruction.operand);
+            break;
+        case OP_SCAN:
+            fprintf(fp, "$ptr %s= %d until $[$ptr] == 0", instruction.offset > 0 ? "+" : "-", abs(instruction.offset));
+            break;
+        case OP_MULMUL:
+            print_cell(fp, instruction.offset);
+            fprintf(fp, " += %d * $[$ptr] * ", (short) instruction.operand);
+            print_cell(fp, instruction.source);
+            break;
+        case OP_GUARD:
+            fputs("check ", fp);
+            print_cell(fp, instruction.offset);
+            fputs("..", fp);
+            print_cell(fp, instruction.offset + (int) instruction.operand);
+            fputs(" once for the loop", fp);
+            break;
+        case OP_END:
+            fputs(INSTRUCTIONS[OP_END], fp);
+            break;
+    }
+}
+
+void ir_emit(ir_t *ir, instruction_t instruction, span_t span) {
+    if (ir->count == ir->capacity) {
+        ir->capacity = ir->capacity ? ir->capacity * 2 : IR_CAPACITY;
+        ir->instructions = (instruction_t*) realloc(ir->instructions, sizeof(instruction_t) * ir->capacity);
+        ir->spans = (span_t*) realloc(ir->spans, sizeof(span_t) * ir->capacity);
+    }
+
+    ir->instructions[ir->count] = instruction;
+    ir->spans[ir->count] = span;
+    ir->count++;
+}
+
+void ir_free(ir_t *ir) {
+    free(ir->instructions);
+    free(ir->spans);
+
+    ir->instructions = NULL;
+    ir->spans = NULL;
+    ir->count = 0;
+    ir->capacity = 0;
+}
+
+bool run_passes(program_t *prog) {
+    for (int i = 0; i < pass_count; ++i) {
+        if (passes[i].level > opt_level) {
+            continue;
+        }
+
+        passes[i].before = prog->ir.count;
+
+        clock_t start = clock();
+
+        if (passes[i].rewrite) {
+            ir_t out = { .count = 0 };
+            passes[i].rewrite(prog, &out);
+
+            ir_free(&prog->ir);
+            prog->ir = out;
+
+            link_jumps(&prog->ir);
+        } else {
+            passes[i].analyze(prog);
+        }
+
+        passes[i].time = (double) (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+        passes[i].after = prog->ir.count;
+
+        long invalid = verify_ir(&prog->ir);
+        if (invalid >= 0) {
+            fprintf(stderr, "\x1B[31mInternal error\x1B[0m: pass '%s' left invalid jumps at instruction %ld.\n", passes[i].name, invalid + 1);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void remove_dead_code(const program_t *prog, ir_t *out) {
+    // Make sure that a program structure is provided
+    if (!prog) {
+        return;
+    }
+
+    const ir_t *ir = &prog->ir;
+
+    /// Whether or not all cells are still zero, as they are at the start of the program
+    bool zeroed = true;
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t instruction = ir->instructions[pc];
+
+        switch (instruction.operator) {
+            case OP_JMP:
+                // A loop is never entered if the current cell is zero, which it is after another loop
+                if (zeroed || (out->count > 0 && out->instructions[out->count - 1].operator == OP_RET)) {
+                    pc = instruction.operand;
+                    continue;
+                }
+                break;
+            case OP_ADD:
+            case OP_SUB: {
+                /// The instruction that undoes this one
+                unsigned short inverse = instruction.operator == OP_ADD ? OP_SUB : OP_ADD;
+
+                if (out->count > 0) {
+                    instruction_t prev = out->instructions[out->count - 1];
+
+                    if (prev.operator == inverse && prev.operand == instruction.operand && prev.offset == instruction.offset) {
+                        out->count--;
+                        continue;
+                    }
+                }
+
+                zeroed = false;
+                break;
+            }
+            case OP_IN:
+                zeroed = false;
+                break;
+        }
+
+        ir_emit(out, instruction, ir->spans[pc]);
+    }
+}
+
+void fold_runs(const program_t *prog, ir_t *out) {
+    // Make sure that a program structure is provided
+    if (!prog) {
+        return;
+    }
+
+    const ir_t *ir = &prog->ir;
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t instruction = ir->instructions[pc];
+
+        switch (instruction.operator) {
+            case OP_INC:
+            case OP_DEC:
+            case OP_ADD:
+            case OP_SUB:
+                if (out->count > 0) {
+                    instruction_t *prev = &out->instructions[out->count - 1];
+
+                    // Only fold while the count still fits into a cell
+                    if (prev->operator == instruction.operator && prev->offset == instruction.offset
+                            && prev->operand + instruction.operand <= USHRT_MAX) {
+                        prev->operand += instruction.operand;
+                        out->spans[out->count - 1] = span_merge(out->spans[out->count - 1], ir->spans[pc]);
+                        continue;
+                    }
+                }
+                break;
+        }
+
+        ir_emit(out, instruction, ir->spans[pc]);
+    }
+}
+
+void fold_clear_loops(const program_t *prog, ir_t *out) {
+    // Make sure that a program structure is provided
+    if (!prog) {
+        return;
+    }
+
+    const ir_t *ir = &prog->ir;
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t *instructions = &ir->instructions[pc];
+
+        // An odd step always reaches zero as the cells wrap around, an even one might loop forever
+        if (pc + 2 < ir->count
+                && instructions[0].operator == OP_JMP
+                && (instructions[1].operator == OP_ADD || instructions[1].operator == OP_SUB)
+                && instructions[1].offset == 0
+                && instructions[1].operand % 2 == 1
+                && instructions[2].operator == OP_RET) {
+            instruction_t clear = { .operator = OP_CLEAR, .operand = 0, .offset = 0 };
+            ir_emit(out, clear, span_merge(ir->spans[pc], ir->spans[pc + 2]));
+
+            pc += 2;
+        } else {
+            ir_emit(out, instructions[0], ir->spans[pc]);
+        }
+    }
+}
+
+void fold_muladd_loops(const program_t *prog, ir_t *out) {
+    // Make sure that a program structure is provided
+    if (!prog) {
+        return;
+    }
+
+    const ir_t *ir = &prog->ir;
+
+    /// The cells the loop adds to, in the order they are first touched
+    ir_t targets = { .count = 0 };
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t instruction = ir->instructions[pc];
+
+        if (instruction.operator != OP_JMP) {
+            ir_emit(out, instruction, ir->spans[pc]);
+            continue;
+        }
+
+        unsigned int ret_pc = instruction.operand;
+
+        // All instructions of the folded loop share its span
+        span_t span = span_merge(ir->spans[pc], ir->spans[ret_pc]);
+
+        /// Whether or not the loop only consists of pointer movement and arithmetic
+        bool simple = true;
+        /// The data pointer relative to the loop's cell
+        int offset = 0;
+        /// The lowest and highest offsets the data pointer passes
+        int min = 0, max = 0;
+        /// The change of the loop's cell per iteration
+        unsigned short step = 0;
+
+        targets.count = 0;
+
+        for (unsigned int i = pc + 1; i < ret_pc && simple; ++i) {
+            instruction_t body = ir->instructions[i];
+
+            switch (body.operator) {
+                case OP_INC:
+                    offset += body.operand;
+                    max = offset > max ? offset : max;
+                    break;
+                case OP_DEC:
+                    offset -= body.operand;
+                    min = offset < min ? offset : min;
+                    break;
+                case OP_ADD:
+                case OP_SUB: {
+                    unsigned short delta = body.operator == OP_ADD ? body.operand : -body.operand;
+                    int cell = offset + body.offset;
+
+                    if (cell == 0) {
+                        step += delta;
+                        break;
+                    }
+
+                    unsigned int t = 0;
+                    while (t < targets.count && targets.instructions[t].offset != cell) {
+                        t++;
+                    }
+
+                    if (t == targets.count) {
+                        instruction_t target = { .operator = OP_MULADD, .operand = 0, .offset = cell };
+                        ir_emit(&targets, target, span);
+                    }
+
+                    targets.instructions[t].operand = (unsigned short) (targets.instructions[t].operand + delta);
+                    break;
+                }
+                default:
+                    simple = false;
+                    break;
+            }
+        }
+
+        // The loop has to end on its own cell, which it has to count down by exactly one
+        simple = simple && offset == 0 && step == USHRT_MAX;
+
+        // Every cell the data pointer passes has to be a target that is emitted, so that the bounds are still checked.
+        // Targets whose additions cancel out, e.g. '<+->', are not emitted
+        int lowest = 0, highest = 0;
+        for (unsigned int t = 0; t < targets.count; ++t) {
+            if (targets.instructions[t].operand == 0) {
+                continue;
+            }
+            lowest = targets.instructions[t].offset < lowest ? targets.instructions[t].offset : lowest;
+            highest = targets.instructions[t].offset > highest ? targets.instructions[t].offset : highest;
+        }
+
+        if (!simple || min < lowest || max > highest) {
+            ir_emit(out, instruction, ir->spans[pc]);
+            continue;
+        }
+
+        for (unsigned int t = 0; t < targets.count; ++t) {
+            if (targets.instructions[t].operand != 0) {
+                ir_emit(out, targets.instructions[t], span);
+            }
+        }
+
+        instruction_t clear = { .operator = OP_CLEAR, .operand = 0, .offset = 0 };
+        ir_emit(out, clear, span);
+
+        pc = ret_pc;
+    }
+
+    ir_free(&targets);
+}
+
+void fold_scan_loops(const program_t *prog, ir_t *out) {
+    // Make sure that a program structure is provided
+    if (!prog) {
+        return;
+    }
+
+    const ir_t *ir = &prog->ir;
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t *instructions = &ir->instructions[pc];
+
+        if (pc + 2 < ir->count
+                && instructions[0].operator == OP_JMP
+                && (instructions[1].operator == OP_INC || instructions[1].operator == OP_DEC)
+                && instructions[2].operator == OP_RET) {
+            int stride = instructions[1].operator == OP_INC ? (int) instructions[1].operand : -(int) instructions[1].operand;
+
+            instruction_t scan = { .operator = OP_SCAN, .operand = 0, .offset = stride };
+            ir_emit(out, scan, span_merge(ir->spans[pc], ir->spans[pc + 2]));
+
+            pc += 2;
+        } else {
+            ir_emit(out, instructions[0], ir->spans[pc]);
+        }
+    }
+}
+
+void fold_offsets(const program_t *prog, ir_t *out) {
+    // Make sure that a program structure is provided
+    if (!prog) {
+        return;
+    }
+
+    const ir_t *ir = &prog->ir;
+
+    /// The pointer movement that has not been emitted yet
+    int offset = 0;
+    /// Whether or not there is pointer movement whose span has not been emitted yet
+    bool moved = false;
+    /// The span of that pointer movement
+    span_t moves;
+    /// The range of offsets the emitted instructions have checked since the data pointer last moved
+    int low = 0, high = 0;
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t instruction = ir->instructions[pc];
+        span_t span = ir->spans[pc];
+
+        switch (instruction.operator) {
+            case OP_INC:
+            case OP_DEC: {
+                int move = instruction.operator == OP_INC ? (int) instruction.operand : -(int) instruction.operand;
+
+                // Turning back from a cell outside of the checked range, e.g. '<>', would skip the check that the
+                // data pointer is still on the tape there, so the movement up to that cell is emitted
+                while ((offset < low && move > 0) || (offset > high && move < 0)) {
+                    unsigned short distance = abs(offset) < USHRT_MAX ? abs(offset) : USHRT_MAX;
+
+                    instruction_t turn = { .operator = offset > 0 ? OP_INC : OP_DEC, .operand = distance, .offset = 0 };
+                    ir_emit(out, turn, moves);
+
+                    offset += offset > 0 ? -distance : distance;
+                    low = high = 0;
+                    moved = false;
+                }
+
+                offset += move;
+                moves = moved ? span_merge(moves, span) : span;
+                moved = true;
+                continue;
+            }
+            case OP_ADD:
+            case OP_SUB:
+            case OP_OUT:
+            case OP_IN:
+            case OP_CLEAR:
+                // The instruction takes over the span of the movement that led to its cell
+                instruction.offset += offset;
+                ir_emit(out, instruction, moved ? span_merge(moves, span) : span);
+                moved = false;
+                low = instruction.offset < low ? instruction.offset : low;
+                high = instruction.offset > high ? instruction.offset : high;
+                continue;
+        }
+
+        // Loops (including the folded ones) need the data pointer to point to their cell
+        while (offset != 0) {
+            unsigned short distance = abs(offset) < USHRT_MAX ? abs(offset) : USHRT_MAX;
+
+            instruction_t move = { .operator = offset > 0 ? OP_INC : OP_DEC, .operand = distance, .offset = 0 };
+            ir_emit(out, move, moves);
+
+            offset += offset > 0 ? -distance : distance;
+            moved = false;
+        }
+
+        // Movement that cancelled itself out is attributed to the loop instruction
+        ir_emit(out, instruction, moved ? span_merge(moves, span) : span);
+        moved = false;
+        low = high = 0;
+    }
+}
+
+bool constant_get(const constants_t *constants, long cell, unsigned short *value) {
+    for (int i = 0; i < constants->count; ++i) {
+        if (constants->cells[i].cell == cell) {
+            *value = constants->cells[i].value;
+            return constants->cells[i].known;
+        }
+    }
+
+    *value = 0;
+    return constants->fresh;
+}
+
+void constant_set(constants_t *constants, long cell, bool known, unsigned short value) {
+    int i = 0;
+    while (i < constants->count && constants->cells[i].cell != cell) {
+        i++;
+    }
+
+    if (i == CONST_CELLS) {
+        // Without room for the cell, it could only be remembered as zero, so no other cell can be either
+        constants->fresh = false;
+        return;
+    }
+
+    if (i == constants->count) {
+        constants->count++;
+    }
+
+    constants->cells[i].cell = cell;
+    constants->cells[i].known = known;
+    constants->cells[i].value = value;
+}
+
+void constant_forget(constants_t *constants) {
+    constants->count = 0;
+    constants->fresh = false;
+}
+
+void constant_emit(constants_t *constants, instruction_t instruction, span_t span, ir_t *out) {
+    long cell = constants->base + instruction.offset;
+    unsigned short value, source;
+
+    switch (instruction.operator) {
+        case OP_INC:
+            constants->base += instruction.operand;
+            break;
+        case OP_DEC:
+            constants->base -= instruction.operand;
+            break;
+        case OP_MULADD:
+            if (!constant_get(constants, constants->base, &source)) {
+                constant_set(constants, cell, false, 0);
+                break;
+            }
+
+            // The loop would not have been entered for an empty cell, so nothing is accessed
+            if (source == 0) {
+                return;
+            }
+
+            // A product that wraps around to zero still has to check its cell, which only OP_MULADD does
+            if ((unsigned short) (instruction.operand * source) == 0) {
+                break;
+            }
+
+            instruction.operator = OP_ADD;
+            instruction.operand = (unsigned short) (instruction.operand * source);
+            // fall through
+        case OP_ADD:
+        case OP_SUB:
+            if (constant_get(constants, cell, &value)) {
+                value += instruction.operator == OP_ADD ? instruction.operand : -instruction.operand;
+                constant_set(constants, cell, true, value);
+            } else {
+                constant_set(constants, cell, false, 0);
+            }
+            break;
+        case OP_CLEAR:
+            constant_set(constants, cell, true, 0);
+            break;
+        case OP_SET:
+            constant_set(constants, cell, true, instruction.operand);
+            break;
+        case OP_IN:
+        case OP_MULMUL:
+            constant_set(constants, cell, false, 0);
+            break;
+    }
+
+    ir_emit(out, instruction, span);
+}
+
+int closed_form_cell(long *cells, affine_t *values, int *count, long cell) {
+    for (int i = 0; i < *count; ++i) {
+        if (cells[i] == cell) {
+            return i;
+        }
+    }
+
+    if (*count == CLOSED_CELLS) {
+        return -1;
+    }
+
+    // Until the loop writes to it, the cell keeps the value it had before the iteration
+    cells[*count] = cell;
+    memset(&values[*count], 0, sizeof(affine_t));
+    values[*count].factors[*count] = 1;
+
+    return (*count)++;
+}
+
+bool constant_closed_form(constants_t *constants, const ir_t *ir, unsigned int pc, ir_t *out) {
+    unsigned int ret_pc = ir->instructions[pc].operand;
+
+    /// The cells the loop accesses relative to its cell, the loop's cell comes first
+    long cells[CLOSED_CELLS];
+    /// The values of those cells after an iteration
+    affine_t values[CLOSED_CELLS];
+    /// The count of those cells
+    int count = 0;
+
+    closed_form_cell(cells, values, &count, 0);
+
+    /// The data pointer relative to the loop's cell
+    long offset = 0;
+
+    for (unsigned int i = pc + 1; i < ret_pc; ++i) {
+        instruction_t body = ir->instructions[i];
+        int target = closed_form_cell(cells, values, &count, offset + body.offset);
+
+        if (target < 0) {
+            return false;
+        }
+
+        switch (body.operator) {
+            case OP_INC:
+                offset += body.operand;
+                break;
+            case OP_DEC:
+                offset -= body.operand;
+                break;
+            case OP_ADD:
+                values[target].constant += body.operand;
+                break;
+            case OP_SUB:
+                values[target].constant -= body.operand;
+                break;
+            case OP_CLEAR:
+                memset(&values[target], 0, sizeof(affine_t));
+                break;
+            case OP_MULADD: {
+                int source = closed_form_cell(cells, values, &count, offset);
+
+                if (source < 0) {
+                    return false;
+                }
+
+                values[target].constant += body.operand * values[source].constant;
+                for (int c = 0; c < count; ++c) {
+                    values[target].factors[c] += body.operand * values[source].factors[c];
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    // The loop has to end on its own cell, which it has to count down by exactly one
+    affine_t counter = { .constant = USHRT_MAX, .factors = { 1 } };
+    if (offset != 0 || memcmp(&values[0], &counter, sizeof(affine_t)) != 0) {
+        return false;
+    }
+
+    /// The values the cells are known to have when the loop is entered
+    unsigned short entry[CLOSED_CELLS];
+    /// Whether or not the value of each cell is known
+    bool known[CLOSED_CELLS];
+    /// Whether or not each cell starts every iteration with the value it had when the loop was entered
+    bool invariant[CLOSED_CELLS];
+
+    for (int i = 0; i < count; ++i) {
+        known[i] = constant_get(constants, constants->base + cells[i], &entry[i]);
+        invariant[i] = i > 0;
+    }
+
+    // Start by assuming every other cell is unchanged and drop the ones that would change under that assumption,
+    // the cells that stay are unchanged in every iteration
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        for (int i = 1; i < count; ++i) {
+            if (!invariant[i]) {
+                continue;
+            }
+
+            affine_t value = values[i];
+            for (int c = 0; c < count; ++c) {
+                if (c != i && invariant[c] && known[c]) {
+                    value.constant += value.factors[c] * entry[c];
+                    value.factors[c] = 0;
+                }
+            }
+
+            bool others = false;
+            for (int c = 0; c < count; ++c) {
+                others = others || (c != i && value.factors[c] != 0);
+            }
+
+            bool kept = value.factors[i] == 1 && value.constant == 0;
+            bool restored = known[i] && value.factors[i] == 0 && value.constant == entry[i];
+
+            if (others || !(kept || restored)) {
+                invariant[i] = false;
+                changed = true;
+            }
+        }
+    }
+
+    span_t span = span_merge(ir->spans[pc], ir->spans[ret_pc]);
+
+    // The instructions are only executed if the loop would have been entered, which makes them run exactly once
+    ir_t closed = { .count = 0 };
+    ir_emit(&closed, ir->instructions[pc], span);
+
+    /// Whether or not each cell is accessed by the emitted instructions, like it is by the loop
+    bool accessed[CLOSED_CELLS] = { true };
+    bool valid = true;
+
+    for (int i = 1; i < count && valid; ++i) {
+        if (invariant[i]) {
+            continue;
+        }
+
+        affine_t value = values[i];
+        for (int c = 0; c < count; ++c) {
+            if (c != i && invariant[c] && known[c]) {
+                value.constant += value.factors[c] * entry[c];
+                value.factors[c] = 0;
+            }
+        }
+
+        // What is added may only depend on the unchanged cells, otherwise it differs between the iterations
+        for (int c = 0; c < count; ++c) {
+            valid = valid && (c == i || value.factors[c] == 0 || invariant[c]);
+        }
+
+        if (!valid || (value.factors[i] != 0 && value.factors[i] != 1)) {
+            valid = false;
+            break;
+        }
+
+        if (value.factors[i] == 1) {
+            // Each iteration adds the same amount, so all of them add it times the loop's cell
+            if (value.constant != 0) {
+                instruction_t muladd = { .operator = OP_MULADD, .operand = value.constant, .offset = cells[i] };
+                ir_emit(&closed, muladd, span);
+            }
+
+            for (int c = 0; c < count; ++c) {
+                if (c != i && value.factors[c] != 0) {
+                    instruction_t mulmul = { .operator = OP_MULMUL, .operand = value.factors[c], .offset = cells[i], .source = cells[c] };
+                    ir_emit(&closed, mulmul, span);
+                    accessed[c] = true;
+                }
+            }
+        } else {
+            // Each iteration sets the cell to the same value, which only the last one matters for
+            for (int c = 0; c < count; ++c) {
+                valid = valid && (c == i || value.factors[c] == 0);
+            }
+
+            instruction_t clear = { .operator = OP_CLEAR, .operand = 0, .offset = cells[i] };
+            ir_emit(&closed, clear, span);
+
+            if (value.constant != 0) {
+                instruction_t add = { .operator = OP_ADD, .operand = value.constant, .offset = cells[i] };
+                ir_emit(&closed, add, span);
+            }
+        }
+
+        accessed[i] = true;
+    }
+
+    // The loop accesses its unchanged cells too, which has to fail the same way if they are off the tape
+    for (int i = 1; i < count && valid; ++i) {
+        if (accessed[i]) {
+            continue;
+        } else if (!known[i]) {
+            valid = false;
+            break;
+        }
+
+        instruction_t clear = { .operator = OP_CLEAR, .operand = 0, .offset = cells[i] };
+        ir_emit(&closed, clear, span);
+
+        if (entry[i] != 0) {
+            instruction_t add = { .operator = OP_ADD, .operand = entry[i], .offset = cells[i] };
+            ir_emit(&closed, add, span);
+        }
+    }
+
+    if (valid) {
+        instruction_t clear = { .operator = OP_CLEAR, .operand = 0, .offset = 0 };
+        ir_emit(&closed, clear, span);
+        ir_emit(&closed, ir->instructions[ret_pc], span);
+
+        for (unsigned int i = 0; i < closed.count; ++i) {
+            ir_emit(out, closed.instructions[i], closed.spans[i]);
+        }
+
+        // Whether or not the loop is entered is not known, so neither are the values of the cells it changes
+        for (int i = 1; i < count; ++i) {
+            if (!invariant[i]) {
+                constant_set(constants, constants->base + cells[i], false, 0);
+            }
+        }
+        constant_set(constants, constants->base, true, 0);
+    }
+
+    ir_free(&closed);
+
+    return valid;
+}
+
+void fold_constants(const program_t *prog, ir_t *out) {
+    // Make sure that a program structure is provided
+    if (!prog) {
+        return;
+    }
+
+    const ir_t *ir = &prog->ir;
+
+    /// What is known about the tape, all cells are zero at the start of the program
+    constants_t constants = { .count = 0, .fresh = true, .base = 0 };
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t instruction = ir->instructions[pc];
+
+        if (instruction.operator == OP_SCAN) {
+            // The data pointer ends up at an unknown but empty cell
+            ir_emit(out, instruction, ir->spans[pc]);
+            constant_forget(&constants);
+            constant_set(&constants, constants.base, true, 0);
+            continue;
+        } else if (instruction.operator != OP_JMP) {
+            constant_emit(&constants, instruction, ir->spans[pc], out);
+            continue;
+        }
+
+        unsigned int ret_pc = instruction.operand;
+        unsigned short value;
+        bool known = constant_get(&constants, constants.base, &value);
+
+        // A loop whose cell is known to be empty is never entered
+        if (known && value == 0) {
+            pc = ret_pc;
+            continue;
+        }
+
+        /// Whether or not the body accesses cells without moving the data pointer or entering another loop
+        bool straight = true;
+        /// Whether or not the loop's cell is only changed by adding to or subtracting from it
+        bool counted = true;
+        /// The change of the loop's cell per iteration
+        unsigned short step = 0;
+
+        for (unsigned int i = pc + 1; i < ret_pc && straight; ++i) {
+            instruction_t body = ir->instructions[i];
+
+            switch (body.operator) {
+                case OP_ADD:
+                case OP_SUB:
+                    if (body.offset == 0) {
+                        step += body.operator == OP_ADD ? body.operand : -body.operand;
+                    }
+                    break;
+                case OP_IN:
+                case OP_CLEAR:
+                case OP_MULADD:
+                    counted = counted && body.offset != 0;
+                    break;
+                case OP_OUT:
+                    break;
+                default:
+                    straight = false;
+                    break;
+            }
+        }
+
+        /// The count of iterations, zero if it is not known or the unrolled loop would be too long
+        unsigned int trips = 0;
+        unsigned int length = ret_pc - pc - 1;
+
+        if (known && straight && counted && step != 0) {
+            for (unsigned int n = 1; n * length <= UNROLL_LIMIT; ++n) {
+                if ((unsigned short) (value + n * step) == 0) {
+                    trips = n;
+                    break;
+                }
+            }
+        }
+
+        if (trips > 0) {
+            for (unsigned int n = 0; n < trips; ++n) {
+                for (unsigned int i = pc + 1; i < ret_pc; ++i) {
+                    constant_emit(&constants, ir->instructions[i], ir->spans[i], out);
+                }
+            }
+
+            pc = ret_pc;
+            continue;
+        }
+
+        if (constant_closed_form(&constants, ir, pc, out)) {
+            pc = ret_pc;
+            continue;
+        }
+
+        for (unsigned int i = pc; i <= ret_pc; ++i) {
+            ir_emit(out, ir->instructions[i], ir->spans[i]);
+        }
+
+        // A straight loop only changes the cells it writes to, any other loop might change every cell
+        if (straight) {
+            for (unsigned int i = pc + 1; i < ret_pc; ++i) {
+                if (ir->instructions[i].operator != OP_OUT) {
+                    constant_set(&constants, constants.base + ir->instructions[i].offset, false, 0);
+                }
+            }
+        } else {
+            constant_forget(&constants);
+        }
+
+        // Either way the loop is left with an empty cell
+        constant_set(&constants, constants.base, true, 0);
+
+        pc = ret_pc;
+    }
+}
+
+void fold_stores(const program_t *prog, ir_t *out) {
+    // Make sure that a program structure is provided
+    if (!prog) {
+        return;
+    }
+
+    const ir_t *ir = &prog->ir;
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t instruction = ir->instructions[pc];
+
+        if (instruction.operator != OP_ADD && instruction.operator != OP_SUB) {
+            ir_emit(out, instruction, ir->spans[pc]);
+            continue;
+        }
+
+        /// The index of the store the instruction is folded into
+        long store = -1;
+
+        // Search back for the last instruction that accesses the same cell, without crossing pointer movement or loops
+        for (long i = (long) out->count - 1; i >= 0 && i >= (long) out->count - STORE_WINDOW; --i) {
+            instruction_t prev = out->instructions[i];
+
+            /// Whether or not the previous instruction accesses the cell or depends on the data pointer staying put
+            bool touches;
+
+            switch (prev.operator) {
+                case OP_ADD:
+                case OP_SUB:
+                case OP_IN:
+                case OP_OUT:
+                    touches = prev.offset == instruction.offset;
+                    break;
+                case OP_CLEAR:
+                case OP_SET:
+                    if (prev.offset == instruction.offset) {
+                        store = i;
+                    }
+                    touches = prev.offset == instruction.offset;
+                    break;
+                case OP_MULADD:
+                    touches = prev.offset == instruction.offset || instruction.offset == 0;
+                    break;
+                case OP_MULMUL:
+                    touches = prev.offset == instruction.offset || prev.source == instruction.offset || instruction.offset == 0;
+                    break;
+                default:
+                    touches = true;
+                    break;
+            }
+
+            if (touches) {
+                break;
+            }
+        }
+
+        if (store < 0) {
+            ir_emit(out, instruction, ir->spans[pc]);
+            continue;
+        }
+
+        instruction_t *set = &out->instructions[store];
+        unsigned short value = set->operator == OP_SET ? set->operand : 0;
+        value += instruction.operator == OP_ADD ? instruction.operand : -instruction.operand;
+
+        set->operator = value != 0 ? OP_SET : OP_CLEAR;
+        set->operand = value;
+        out->spans[store] = span_merge(out->spans[store], ir->spans[pc]);
+    }
+}
+
+void evaluate_prefix(program_t *prog) {
+    // Make sure that a program structure is provided
+    if (!prog) {
+        return;
+    }
+
+    /// The runtime to evaluate the program on, static because of the size of its tape
+    static runtime_t scratch;
+
+    memset(scratch.data, 0, sizeof(unsigned short) * DATA_SIZE);
+    scratch.pc = 0;
+    scratch.ptr = 0;
+    scratch.guarded = false;
+
+    unsigned long steps = 0;
+    for (; steps < PREFIX_STEPS; ++steps) {
+        instruction_t instruction = prog->ir.instructions[scratch.pc];
+
+        // Stop before the first instruction that depends on or affects the outside world
+        if (instruction.operator == OP_IN || instruction.operator == OP_OUT || instruction.operator == OP_END) {
+            break;
+        }
+
+        // A runtime error has to be reported when the program is actually run, so it starts from the beginning
+        if (runtime_exec(&scratch, instruction) != HALT_NONE) {
+            memset(scratch.data, 0, sizeof(unsigned short) * DATA_SIZE);
+            scratch.pc = 0;
+            scratch.ptr = 0;
+            steps = 0;
+            break;
+        }
+    }
+
+    memcpy(prog->init_data, scratch.data, sizeof(unsigned short) * DATA_SIZE);
+    prog->init_ptr = scratch.ptr;
+    prog->init_pc = scratch.pc;
+    prog->prefix_steps = steps;
+}
+
+void fuse_instructions(const program_t *prog, ir_t *out) {
+    // Make sure that a program structure is provided
+    if (!prog) {
+        return;
+    }
+
+    const ir_t *ir = &prog->ir;
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t instruction = ir->instructions[pc];
+        span_t span = ir->spans[pc];
+
+        for (int f = 0; f < fusion_count && pc + 1 < ir->count; ++f) {
+            if (FUSIONS[f].first == instruction.operator && FUSIONS[f].second == ir->instructions[pc + 1].operator) {
+                int distance = instruction.operator == OP_INC ? (int) instruction.operand : -(int) instruction.operand;
+
+                instruction = ir->instructions[pc + 1];
+                instruction.operator = FUSIONS[f].fused;
+                instruction.offset = distance;
+                span = span_merge(span, ir->spans[pc + 1]);
+
+                pc++;
+                break;
+            }
+        }
+
+        ir_emit(out, instruction, span);
+    }
+}
+
+void hoist_bounds_checks(const program_t *prog, ir_t *out) {
+    // Make sure that a program structure is provided
+    if (!prog) {
+        return;
+    }
+
+    const ir_t *ir = &prog->ir;
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t instruction = ir->instructions[pc];
+
+        if (instruction.operator != OP_JMP) {
+            ir_emit(out, instruction, ir->spans[pc]);
+            continue;
+        }
+
+        unsigned int ret_pc = instruction.operand;
+
+        /// Whether or not the body only moves the data pointer and accesses cells
+        bool straight = ir->instructions[ret_pc].operator == OP_RET;
+        /// The data pointer relative to the loop's cell
+        long offset = 0;
+        /// The lowest and highest cells the body accesses relative to the loop's cell
+        long lowest = 0, highest = 0;
+
+        for (unsigned int i = pc + 1; i < ret_pc && straight; ++i) {
+            instruction_t body = ir->instructions[i];
+
+            switch (body.operator) {
+                case OP_INC:
+                    offset += body.operand;
+                    break;
+                case OP_DEC:
+                    offset -= body.operand;
+                    break;
+                case OP_ADD:
+                case OP_SUB:
+                case OP_OUT:
+                case OP_IN:
+                case OP_CLEAR:
+                case OP_SET:
+                case OP_MULADD:
+                    break;
+                case OP_MULMUL:
+                    lowest = offset + body.source < lowest ? offset + body.source : lowest;
+                    highest = offset + body.source > highest ? offset + body.source : highest;
+                    break;
+                default:
+                    straight = false;
+                    continue;
+            }
+
+            long cell = offset + body.offset;
+            lowest = cell < lowest ? cell : lowest;
+            highest = cell > highest ? cell : highest;
+        }
+
+        // The data pointer has to be back at the loop's cell after each iteration for a single check to cover all of them
+        if (!straight || offset != 0 || (lowest == 0 && highest == 0) || highest - lowest >= DATA_SIZE) {
+            ir_emit(out, instruction, ir->spans[pc]);
+            continue;
+        }
+
+        instruction_t guard = { .operator = OP_GUARD, .operand = highest - lowest, .offset = lowest };
+        ir_emit(out, guard, ir->spans[pc]);
+        ir_emit(out, instruction, ir->spans[pc]);
+
+        for (unsigned int i = pc + 1; i < ret_pc; ++i) {
+            instruction_t body = ir->instructions[i];
+            body.flags |= IF_UNCHECKED;
+
+            ir_emit(out, body, ir->spans[i]);
+        }
+
+        ir_emit(out, ir->instructions[ret_pc], ir->spans[ret_pc]);
+
+        pc = ret_pc;
+    }
+}
+
+void analyze_bounds(program_t *prog) {
+    // Make sure that a program structure is provided
+    if (!prog) {
+        return;
+    }
+
+    const ir_t *ir = &prog->ir;
+
+    /// The stack of the data pointer ranges at the start of the open loops' bodies
+    long heads[STACK_SIZE][2];
+    /// The stack pointer
+    unsigned int esp = 0;
+
+    /// The range of the data pointer, the program starts at the first cell
+    long low = 0, high = 0;
+
+    prog->bounds = BOUNDS_PROVEN;
+    prog->bounds_pc = 0;
+    prog->bounds_low = 0;
+    prog->bounds_high = 0;
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t instruction = ir->instructions[pc];
+
+        /// The change of the data pointer before the instruction accesses a cell
+        long move = 0;
+        /// The offset of the cell the instruction accesses
+        long cell = 0;
+
+        switch (instruction.operator) {
+            case OP_INC:
+                move = instruction.operand;
+                break;
+            case OP_DEC:
+                move = -(long) instruction.operand;
+                break;
+            case OP_MOVE_JMP:
+            case OP_MOVE_RET:
+                move = instruction.offset;
+                break;
+            case OP_ADD:
+            case OP_SUB:
+            case OP_OUT:
+            case OP_IN:
+            case OP_CLEAR:
+            case OP_SET:
+            case OP_MULADD:
+                cell = instruction.offset;
+                break;
+            case OP_MULMUL:
+                // The source is checked like a second access, the one to the offset follows below
+                if (low + instruction.source < 0 || high + instruction.source >= DATA_SIZE) {
+                    prog->bounds = BOUNDS_OFF_TAPE;
+                    prog->bounds_pc = pc;
+                    prog->bounds_low = low + instruction.source < 0 ? low + instruction.source : high + instruction.source;
+                    return;
+                }
+                prog->bounds_low = low + instruction.source < prog->bounds_low ? low + instruction.source : prog->bounds_low;
+                prog->bounds_high = high + instruction.source > prog->bounds_high ? high + instruction.source : prog->bounds_high;
+                cell = instruction.offset;
+                break;
+            case OP_SCAN:
+                // The distance depends on the tape's contents, so it cannot be known ahead of time
+                prog->bounds = BOUNDS_SCAN;
+                prog->bounds_pc = pc;
+                return;
+        }
+
+        low += move;
+        high += move;
+
+        if (low + cell < 0 || high + cell >= DATA_SIZE) {
+            prog->bounds = BOUNDS_OFF_TAPE;
+            prog->bounds_pc = pc;
+            prog->bounds_low = low + cell < 0 ? low + cell : high + cell;
+            return;
+        }
+
+        prog->bounds_low = low + cell < prog->bounds_low ? low + cell : prog->bounds_low;
+        prog->bounds_high = high + cell > prog->bounds_high ? high + cell : prog->bounds_high;
+
+        switch (instruction.operator) {
+            case OP_JMP:
+            case OP_MOVE_JMP:
+                heads[esp][0] = low;
+                heads[esp][1] = high;
+                esp++;
+                break;
+            case OP_RET:
+            case OP_MOVE_RET:
+                esp--;
+
+                // Every iteration has to start within the range of the first one, otherwise the loop drifts along the tape
+                if (low < heads[esp][0] || high > heads[esp][1]) {
+                    prog->bounds = BOUNDS_DRIFT;
+                    prog->bounds_pc = instruction.operand;
+                    return;
+                }
+
+                // The loop is either skipped or left from its end, both with the range it started with
+                low = heads[esp][0];
+                high = heads[esp][1];
+                break;
+        }
+    }
+}
+
+void link_jumps(ir_t *ir) {
+    /// The stack that is used to keep track of the open loops
+    unsigned int stack[STACK_SIZE];
+    /// The stack pointer
+    unsigned int esp = 0;
+
+    // Unbalanced loops are left as they are for verify_ir to report
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        switch (ir->instructions[pc].operator) {
+            case OP_JMP:
+            case OP_MOVE_JMP:
+                if (esp == STACK_SIZE) {
+                    return;
+                }
+                stack[esp++] = pc;
+                break;
+            case OP_RET:
+            case OP_MOVE_RET: {
+                if (esp == 0) {
+                    return;
+                }
+                unsigned int jmp_pc = stack[--esp];
+                ir->instructions[pc].operand = jmp_pc;
+                ir->instructions[jmp_pc].operand = pc;
+                break;
+            }
+        }
+    }
+}
+
+long verify_ir(const ir_t *ir) {
+    /// The stack that is used to keep track of the open loops
+    unsigned int stack[STACK_SIZE];
+    /// The stack pointer
+    unsigned int esp = 0;
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t instruction = ir->instructions[pc];
+
+        if (instruction.operator > OP_SET) {
+            return pc;
+        }
+
+        switch (instruction.operator) {
+            case OP_JMP:
+            case OP_MOVE_JMP:
+                if (esp == STACK_SIZE) {
+                    return pc;
+                }
+                stack[esp++] = pc;
+                break;
+            case OP_RET:
+            case OP_MOVE_RET: {
+                if (esp == 0) {
+                    return pc;
+                }
+                unsigned int jmp_pc = stack[--esp];
+                if (instruction.operand != jmp_pc || ir->instructions[jmp_pc].operand != pc) {
+                    return pc;
+                }
+                break;
+            }
+            case OP_GUARD:
+                // A guard only covers the loop right behind it
+                if (pc + 1 == ir->count || ir->instructions[pc + 1].operator != OP_JMP) {
+                    return pc;
+                }
+                break;
+            case OP_END:
+                // The program has to end exactly once, at its last instruction
+                if (pc + 1 != ir->count) {
+                    return pc;
+                }
+                break;
+        }
     }
 
     if (esp != 0) {
+        return stack[esp - 1];
+    }
+
+    if (ir->count == 0 || ir->instructions[ir->count - 1].operator != OP_END) {
+        return ir->count;
+    }
+
+    return -1;
+}
+
+bool compile_cached(FILE *fp, program_t *prog, bool *cached) {
+    *cached = false;
+
+    // The whole source is hashed, comments included, as they move the spans. It is compiled from memory, as fp could be
+    // a pipe that cannot be read a second time
+    size_t size;
+    char *source = read_source(fp, &size);
+    uint64_t key = cache_key(source, size, opt_level);
+    char *path = cache_path(key);
+
+    if (path && cache_read(path, key, prog)) {
+        *cached = true;
+        free(path);
+        free(source);
+        return true;
+    }
+
+    bool compiled = compile_source(source, size, prog);
+
+    // The cache only makes loading faster, so a program is still loaded if it cannot be stored
+    if (compiled && path && cache_matches(prog, source, size)) {
+        cache_write(path, key, prog);
+    }
+
+    free(path);
+    free(source);
+
+    return compiled;
+}
+
+uint64_t cache_hash(uint64_t hash, const void *bytes, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ ((const unsigned char*) bytes)[i]) * 0x100000001B3;
+    }
+
+    return hash;
+}
+
+uint64_t cache_key(const char *source, size_t size, int level) {
+    unsigned char byte = level;
+
+    return cache_hash(cache_hash(CACHE_HASH_START, source, size), &byte, 1);
+}
+
+bool cache_matches(const program_t *prog, const char *source, size_t size) {
+    unsigned int count = 0;
+
+    for (size_t i = 0; i < size; ++i) {
+        if (source[i] && strchr("<>+-.,[]", source[i])) {
+            if (count == prog->code_len || prog->code[count] != source[i]) {
+                return false;
+            }
+            count++;
+        }
+    }
+
+    return count == prog->code_len;
+}
+
+bool cache_check_guards(const ir_t *ir) {
+    /// The program without its guards, allocated because of the size of its initial tape
+    program_t *unguarded = (program_t*) calloc(1, sizeof(program_t));
+
+    for (unsigned int pc = 0; pc < ir->count; ++pc) {
+        instruction_t instruction = ir->instructions[pc];
+        instruction.flags &= ~IF_UNCHECKED;
+
+        if (instruction.operator != OP_GUARD) {
+            ir_emit(&unguarded->ir, instruction, ir->spans[pc]);
+        }
+    }
+
+    link_jumps(&unguarded->ir);
+
+    for (int i = 0; i < pass_count; ++i) {
+        if (passes[i].rewrite == &hoist_bounds_checks && passes[i].level <= opt_level) {
+            ir_t guarded = { .count = 0 };
+            hoist_bounds_checks(unguarded, &guarded);
+            link_jumps(&guarded);
+
+            ir_free(&unguarded->ir);
+            unguarded->ir = guarded;
+        }
+    }
+
+    bool same = unguarded->ir.count == ir->count
+             && memcmp(unguarded->ir.instructions, ir->instructions, sizeof(instruction_t) * ir->count) == 0;
+
+    ir_free(&unguarded->ir);
+    free(unguarded);
+
+    return same;
+}
+
+uint64_t cache_build() {
+    const char built[] = __DATE__ " " __TIME__;
+    uint64_t hash = cache_hash(CACHE_HASH_START, built, sizeof(built) - 1);
+
+    for (int i = 0; i < pass_count; ++i) {
+        unsigned char level = passes[i].level;
+        hash = cache_hash(hash, passes[i].name, strlen(passes[i].name));
+        hash = cache_hash(hash, &level, 1);
+    }
+
+    return hash;
+}
+
+char *cache_path(uint64_t key) {
+#ifdef POSIX
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char *dir = NULL;
+
+    if (cache_home && cache_home[0]) {
+        dir = strdup(cache_home);
+    } else if (home && home[0]) {
+        dir = (char*) malloc(strlen(home) + sizeof("/.cache"));
+        sprintf(dir, "%s/.cache", home);
+    } else {
+        return NULL;
+    }
+
+    // The directories usually exist already, any other problem shows when the file is opened
+    mkdir(dir, 0755);
+
+    char *path = (char*) malloc(strlen(dir) + sizeof("/" CACHE_DIR "/0123456789abcdef.bfc"));
+    sprintf(path, "%s/%s", dir, CACHE_DIR);
+    mkdir(path, 0755);
+    sprintf(path, "%s/%s/%016llx.bfc", dir, CACHE_DIR, (unsigned long long) key);
+
+    free(dir);
+
+    return path;
+#else
+    (void) key;
+
+    return NULL;
+#endif
+}
+
+bool cache_read(const char *path, uint64_t key, program_t *prog) {
+#ifdef POSIX
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
         return false;
     }
-    
-    prog->instructions[pc].operator = OP_END;
-    prog->instr_count = pc + 1;
 
-    return true;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(cache_header_t)) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    const unsigned char *file = (const unsigned char*) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (file == MAP_FAILED) {
+        return false;
+    }
+
+    cache_header_t header;
+    memcpy(&header, file, sizeof(header));
+
+    size_t instructions = sizeof(header);
+    size_t spans = instructions + (size_t) header.count * sizeof(instruction_t);
+    size_t cells = spans + (size_t) header.count * sizeof(span_t);
+    size_t code = cells + (size_t) header.cells * sizeof(cache_cell_t);
+
+    bool valid = header.version == CACHE_VERSION && header.instruction_size == sizeof(instruction_t)
+              && header.span_size == sizeof(span_t) && header.data_size == DATA_SIZE && header.build == cache_build()
+              && header.key == key && header.count > 0 && header.cells <= DATA_SIZE && header.init_pc < header.count && header.init_ptr < DATA_SIZE
+              && size == code + header.code_len
+              && header.checksum == cache_hash(CACHE_HASH_START, &file[instructions], size - instructions);
+
+    if (valid) {
+        ir_t ir = {
+            .instructions = (instruction_t*) malloc(sizeof(instruction_t) * header.count),
+            .spans = (span_t*) malloc(sizeof(span_t) * header.count),
+            .count = header.count, .capacity = header.count
+        };
+        memcpy(ir.instructions, &file[instructions], sizeof(instruction_t) * header.count);
+        memcpy(ir.spans, &file[spans], sizeof(span_t) * header.count);
+
+        // The checksum does not protect against files that were written to look valid, a program with broken jumps,
+        // spans outside of its source or guards that do not cover their loops is compiled again
+        valid = verify_ir(&ir) == -1 && cache_check_guards(&ir);
+
+        for (unsigned int pc = 0; valid && pc < ir.count; ++pc) {
+            valid = ir.spans[pc].start <= ir.spans[pc].end && ir.spans[pc].end <= header.code_len;
+        }
+
+        const cache_cell_t *cell = (const cache_cell_t*) &file[cells];
+        for (unsigned int i = 0; valid && i < header.cells; ++i) {
+            valid = cell[i].index < DATA_SIZE && cell[i].value <= USHRT_MAX;
+        }
+
+        if (valid) {
+            program_free(prog);
+
+            prog->ir = ir;
+            prog->code = (char*) malloc(header.code_len ? header.code_len : 1);
+            memcpy(prog->code, &file[code], header.code_len);
+            prog->code_len = header.code_len;
+            memset(prog->init_data, 0, sizeof(prog->init_data));
+            for (unsigned int i = 0; i < header.cells; ++i) {
+                prog->init_data[cell[i].index] = cell[i].value;
+            }
+            prog->init_ptr = header.init_ptr;
+            prog->init_pc = header.init_pc;
+            prog->prefix_steps = header.prefix_steps;
+            prog->bounds = BOUNDS_UNANALYZED;
+            prog->bounds_pc = 0;
+
+            // Whether the bounds checks can be left out is decided from the instructions alone, not the file
+            for (int i = 0; i < pass_count; ++i) {
+                if (passes[i].analyze == &analyze_bounds && passes[i].level <= opt_level) {
+                    analyze_bounds(prog);
+                }
+            }
+        } else {
+            ir_free(&ir);
+        }
+    }
+
+    munmap((void*) file, size);
+
+    return valid;
+#else
+    (void) path;
+    (void) key;
+    (void) prog;
+
+    return false;
+#endif
 }
 
-void compile_error(int line, int col, const char *fmt, ...) {
-    fprintf(stderr, "%d:%d: \x1B[31mcompilation error\x1B[0m: ", line, col);
+bool cache_write(const char *path, uint64_t key, const program_t *prog) {
+#ifdef POSIX
+    cache_header_t header = {
+        .version = CACHE_VERSION, .instruction_size = sizeof(instruction_t), .span_size = sizeof(span_t),
+        .data_size = DATA_SIZE, .build = cache_build(), .key = key, .count = prog->ir.count, .code_len = prog->code_len,
+        .init_ptr = prog->init_ptr, .init_pc = prog->init_pc, .prefix_steps = prog->prefix_steps
+    };
+
+    // Most of the tape is still zero after the prefix, if it ran at all
+    for (unsigned int i = 0; i < DATA_SIZE; ++i) {
+        header.cells += prog->init_data[i] != 0;
+    }
 
-    va_list vl;
-    va_start(vl, fmt);
-    vfprintf(stderr, fmt, vl);
-    va_end(vl);
+    cache_cell_t *cells = (cache_cell_t*) malloc(sizeof(cache_cell_t) * (header.cells ? header.cells : 1));
+    for (unsigned int i = 0, count = 0; i < DATA_SIZE; ++i) {
+        if (prog->init_data[i]) {
+            cells[count++] = (cache_cell_t) { .index = i, .value = prog->init_data[i] };
+        }
+    }
 
-    fprintf(stdout, "Compilation exited with \x1B[31merror\x1B[0m.\n");
+    header.checksum = cache_hash(CACHE_HASH_START, prog->ir.instructions, sizeof(instruction_t) * prog->ir.count);
+    header.checksum = cache_hash(header.checksum, prog->ir.spans, sizeof(span_t) * prog->ir.count);
+    header.checksum = cache_hash(header.checksum, cells, sizeof(cache_cell_t) * header.cells);
+    header.checksum = cache_hash(header.checksum, prog->code, prog->code_len);
+
+    // The file is written under another name and then renamed, so that no other bfdb maps it half written
+    char *temp = (char*) malloc(strlen(path) + sizeof(".4294967295"));
+    sprintf(temp, "%s.%u", path, (unsigned int) getpid());
+
+    FILE *fp = fopen(temp, "wb");
+
+    if (!fp) {
+        free(cells);
+        free(temp);
+        return false;
+    }
+
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(prog->ir.instructions, sizeof(instruction_t), prog->ir.count, fp);
+    fwrite(prog->ir.spans, sizeof(span_t), prog->ir.count, fp);
+    fwrite(cells, sizeof(cache_cell_t), header.cells, fp);
+    fwrite(prog->code, 1, prog->code_len, fp);
+    free(cells);
+
+    bool written = !ferror(fp);
+    written = fclose(fp) == 0 && written && rename(temp, path) == 0;
+
+    if (!written) {
+        remove(temp);
+    }
+
+    free(temp);
+
+    return written;
+#else
+    (void) path;
+    (void) key;
+    (void) prog;
+
+    return false;
+#endif
 }
 
 void parse_command(const char *cmd) {
@@ -440,12 +4687,17 @@ void parse_command(const char *cmd) {
     for (int i = 0; i < command_count; ++i) {
         const command_t command = commands[i];
 
-        if (strcmp(split_cmd[0], command.name) == 0 || split_cmd[0][0] == command.abbr) {
+        // The abbreviation matches on its own or as the start of the name, e.g. 'c' or 'cont' for 'continue'
+        bool abbreviated = split_cmd[0][0] == command.abbr
+                        && (split_cmd[0][1] == '\0' || strncmp(split_cmd[0], command.name, strlen(split_cmd[0])) == 0);
+
+        if (strcmp(split_cmd[0], command.name) == 0 || abbreviated) {
             // Whether or not an argument was provided
             char *arg = (count == 2) ? split_cmd[1] : NULL;
 
             command.handler(arg);
             executed = true;
+            break;
         }
     }
 
@@ -470,11 +4722,14 @@ void cmd_help(char *unused) {
     for (int i = 0; i < command_count; ++i) {
         const command_t command = commands[i];
 
-        // Skip first character in the command's name as it is already printed in the brackets (the abbreviation)
+        // The abbreviation is printed in brackets in place of its first occurrence in the command's name
+        int at = (int) (strchr(command.name, command.abbr) - command.name);
+        fprintf(stdout, "%.*s(%c)%s", at, command.name, command.abbr, &command.name[at + 1]);
+
         if (command.arg_desc) {
-            fprintf(stdout, "(%c)%s %s -- %s.\n", command.abbr, &command.name[1], command.arg_desc, command.desc);
+            fprintf(stdout, " %s -- %s.\n", command.arg_desc, command.desc);
         } else {
-            fprintf(stdout, "(%c)%s -- %s.\n", command.abbr, &command.name[1], command.desc);
+            fprintf(stdout, " -- %s.\n", command.desc);
         }
     }
 }
@@ -537,13 +4792,28 @@ void cmd_continue(char *unused) {
     (void) unused;
 
     if (runtime.running) {
-        // Continue stepping in execution until the runtime stops because of OP_END or a runtime error
-        while (!dbg_next(1)) {}
+        // Run until the runtime stops because of OP_END, a runtime error, a breakpoint or an interrupt
+        dbg_halt(&runtime, dbg_execute(ULONG_MAX));
     } else {
         fprintf(stdout, "The program is not being run.\n");
     }
 }
 
+void cmd_break(char *index) {
+    if (loaded) {
+        if (index) {
+            int i;
+            if (to_int(index, 10, false, &i)) {
+                dbg_toggle_breakpoint(&program, i);
+            }
+        } else {
+            dbg_print_breakpoints();
+        }
+    } else {
+        fprintf(stdout, "No brainfuck file specified, use 'file'.\n");
+    }
+}
+
 void cmd_dataptr(char *index) {
     if (runtime.running) {
         if (index) {
@@ -567,7 +4837,9 @@ void cmd_print(char *index) {
                 dbg_print(i);
             }
         } else {
-            dbg_print(runtime.ptr);
+            engine_state_t state;
+            engine->read_state(&runtime, &state);
+            dbg_print(state.ptr);
         }
     } else {
         fprintf(stdout, "The program is not being run.\n");
@@ -589,13 +4861,67 @@ void cmd_set(char *value) {
         if (value) {
             int v;
             if (to_int(value, 10, false, &v)) {
-                dbg_set_cell(runtime.ptr, v);
+                engine_state_t state;
+                engine->read_state(&runtime, &state);
+                dbg_set_cell(state.ptr, v);
             }
         } else {
             fprintf(stderr, "\x1B[31mError\x1B[0m: 'set' takes exactly one value argument.\n");
         }
     } else {
-        fprintf(stdout, "The program is not being run.\n");
+        fprintf(stdout, "The program is not being run.\n");
+    }
+}
+
+void cmd_engine(char *name) {
+    if (name) {
+        dbg_set_engine(name);
+    } else {
+        dbg_print_engines();
+    }
+}
+
+void cmd_optimize(char *level) {
+    if (level) {
+        int l;
+        if (to_int(level, 10, false, &l) && dbg_set_opt_level(l) && loaded_file) {
+            // Copy the name as dbg_load replaces it
+            char *file_name = strdup(loaded_file);
+            dbg_load(file_name);
+            free(file_name);
+        }
+    } else {
+        fprintf(stdout, "Optimization level: -O%d.\n", opt_level);
+    }
+}
+
+void cmd_info(char *unused) {
+    (void) unused;
+
+    if (loaded) {
+        dbg_print_info();
+    } else {
+        fprintf(stdout, "No brainfuck file specified, use 'file'.\n");
+    }
+}
+
+void cmd_emit_c(char *file_name) {
+    if (!loaded) {
+        fprintf(stdout, "No brainfuck file specified, use 'file'.\n");
+    } else if (file_name) {
+        dbg_emit_c(file_name);
+    } else {
+        fprintf(stderr, "\x1B[31mError\x1B[0m: 'emit-c' takes exactly one file path argument.\n");
+    }
+}
+
+void cmd_emit_elf(char *file_name) {
+    if (!loaded) {
+        fprintf(stdout, "No brainfuck file specified, use 'file'.\n");
+    } else if (file_name) {
+        dbg_emit_elf(file_name);
+    } else {
+        fprintf(stderr, "\x1B[31mError\x1B[0m: 'emit-elf' takes exactly one file path argument.\n");
     }
 }
 
@@ -608,10 +4934,32 @@ void dbg_load(const char *const file_name) {
     if (fp) {
         fprintf(stdout, "Reading %s...\n", file_name);
 
-        loaded = compile(fp, &program);
+        bool cached;
+        loaded = compile_cached(fp, &program, &cached);
 
         if (!loaded) {
             fprintf(stderr, "Could not read from %s.\n", file_name);
+        } else {
+            // Breakpoints only carry over when the same file is loaded again, e.g. by 'optimize'
+            if (!loaded_file || strcmp(loaded_file, file_name) != 0) {
+                breakpoint_count = 0;
+            }
+
+            free(loaded_file);
+            loaded_file = strdup(file_name);
+
+            dbg_apply_breakpoints(&program);
+            engine->init(&program);
+
+            if (cached) {
+                fprintf(stdout, "Compiled to %d instructions with -O%d, read from the cache.\n", program.ir.count, opt_level);
+            } else {
+                dbg_print_pass_stats();
+            }
+
+            if (program.prefix_steps > 0) {
+                fprintf(stdout, "Executed %lu instructions ahead of time, execution starts at instruction %d.\n", program.prefix_steps, program.ir.spans[program.init_pc].start + 1);
+            }
         }
 
         fclose(fp);
@@ -620,6 +4968,100 @@ void dbg_load(const char *const file_name) {
     }
 }
 
+bool dbg_set_opt_level(int level) {
+    if (level < 0 || level > MAX_OPT_LEVEL) {
+        fprintf(stderr, "%d: Not in range of optimization levels [0..%d].\n", level, MAX_OPT_LEVEL);
+        return false;
+    } else {
+        opt_level = level;
+        return true;
+    }
+}
+
+bool dbg_emit_c(const char *const file_name) {
+    FILE *fp = fopen(file_name, "w");
+
+    if (!fp) {
+        fprintf(stderr, "%s: Could not open file for writing.\n", file_name);
+        return false;
+    }
+
+    emit_c(fp, &program, loaded_file);
+
+    if (!close_written(fp, file_name)) {
+        return false;
+    }
+
+    fprintf(stdout, "Wrote %s.\n", file_name);
+
+    return true;
+}
+
+bool dbg_emit_elf(const char *const file_name) {
+#ifdef JIT
+    FILE *fp = fopen(file_name, "wb");
+
+    if (!fp) {
+        fprintf(stderr, "%s: Could not open file for writing.\n", file_name);
+        return false;
+    }
+
+    emit_elf(fp, &program);
+
+    if (!close_written(fp, file_name)) {
+        return false;
+    }
+
+    chmod(file_name, 0755);
+    fprintf(stdout, "Wrote %s.\n", file_name);
+
+    return true;
+#else
+    (void) file_name;
+
+    fprintf(stderr, "\x1B[31mError\x1B[0m: executables can only be written on x86-64 Linux.\n");
+    return false;
+#endif
+}
+
+void dbg_print_info() {
+    fprintf(stdout, "Program: %s, %d instructions compiled to %d with -O%d.\n", loaded_file, program.code_len, program.ir.count, opt_level);
+
+    /// The source index of the instruction that kept the analysis from proving the bounds, if it failed
+    unsigned int index;
+
+    switch (program.bounds) {
+        case BOUNDS_PROVEN:
+            fprintf(stdout, "Bounds: $ptr stays within [%ld..%ld], running without bounds checks.\n", program.bounds_low, program.bounds_high);
+            break;
+        case BOUNDS_UNANALYZED:
+            fprintf(stdout, "Bounds: checked, $ptr is only analyzed with -O2 and above.\n");
+            break;
+        case BOUNDS_DRIFT:
+            index = program.ir.spans[program.bounds_pc].start + 1;
+            fprintf(stdout, "Bounds: checked, the loop at instruction %d does not return to its cell after each iteration.\n", index);
+            break;
+        case BOUNDS_SCAN:
+            index = program.ir.spans[program.bounds_pc].start + 1;
+            fprintf(stdout, "Bounds: checked, the scan at instruction %d moves $ptr until it finds an empty cell.\n", index);
+            break;
+        case BOUNDS_OFF_TAPE:
+            index = program.ir.spans[program.bounds_pc].start + 1;
+            fprintf(stdout, "Bounds: checked, instruction %d can access $[%ld], which is off the tape.\n", index, program.bounds_low);
+            break;
+    }
+}
+
+void dbg_print_pass_stats() {
+    fprintf(stdout, "Compiled to %d instructions with -O%d.\n", program.ir.count, opt_level);
+
+    for (int i = 0; i < pass_count; ++i) {
+        if (passes[i].level <= opt_level) {
+            fprintf(stdout, "  %-18s %5d -> %5d instructions in %.3f ms.\n", passes[i].name, passes[i].before, passes[i].after, passes[i].time);
+        }
+    }
+}
+
 void dbg_runtime_error(const char *fmt, ...) {
     fprintf(stderr, "\n\x1B[31mRuntime error\x1B[0m: ");
 
@@ -628,77 +5070,43 @@ void dbg_runtime_error(const char *fmt, ...) {
     vfprintf(stderr, fmt, vl);
     va_end(vl);
 
-    unsigned short operator = program.instructions[runtime.pc].operator;
-    fprintf(stderr, "At instruction %d ('%s'). $[$ptr: %d]: %d.\n", runtime.pc + 1, INSTRUCTIONS[operator], runtime.ptr, runtime.data[runtime.ptr]);
+    span_t span = program.ir.spans[runtime.pc];
+    fprintf(stderr, "At instruction %d (%d:%d '", span.start + 1, span.line, span.col);
+    print_span(stderr, &program, span);
+    fprintf(stderr, "'). $[$ptr: %d]: %d.\n", runtime.ptr, runtime.data[runtime.ptr]);
 
     fprintf(stdout, "Brainfuck exited with \x1B[31merror\x1B[0m.\n");
     runtime.running = false;
 }
 
 void dbg_run() {
-    memset(runtime.data, 0, sizeof(unsigned short) * DATA_SIZE);
+    runtime_reset(&runtime, &program);
 
-    runtime.pc = 0;
-    runtime.ptr = 0;
+    runtime.input = stdin;
+    runtime.output = stdout;
     runtime.running = true;
 }
 
-bool dbg_interpret(runtime_t *runtime, instruction_t instruction) {
-    // Make sure that a runtime is provided
-    if (!runtime) {
-        return false;
-    }
-
-    if (instruction.operator == OP_END) {
-        fprintf(stdout, "\n\x1B[32mNote\x1B[0m: Brainfuck exited normally.\n");
-        runtime->running = false;
-
-        return true;
-    } else {
-        switch (instruction.operator) {
-            case OP_INC:
-                if (runtime->ptr + 1 < DATA_SIZE) {
-                    runtime->ptr++;
-                } else {
-                    dbg_runtime_error("trying to increment the data pointer out of range (%d).\n", DATA_SIZE);
-                    return true;
-                }
-                break;
-            case OP_DEC:
-                if (runtime->ptr > 0) {
-                    runtime->ptr--;
-                } else {
-                    dbg_runtime_error("trying to decrement the data pointer below 0.\n");
-                    return true;
-                }
-                break;
-            case OP_ADD:
-                runtime->data[runtime->ptr]++;
-                break;
-            case OP_SUB:
-                runtime->data[runtime->ptr]--;
-                break;
-            case OP_OUT:
-                putchar(runtime->data[runtime->ptr]);
-                break;
-            case OP_IN:
-                runtime->data[runtime->ptr] = (unsigned int) getchar();
-                break;
-            case OP_JMP:
-                if (!runtime->data[runtime->ptr]) {
-                    runtime->pc = instruction.operand;
-                }
-                break;
-            case OP_RET:
-                if (runtime->data[runtime->ptr]) {
-                    runtime->pc = instruction.operand;
-                }
-                break;
-            }
-
-        runtime->pc++;
-
-        return false;
+bool dbg_halt(runtime_t *runtime, int halt) {
+    switch (halt) {
+        case HALT_END:
+            fprintf(stdout, "\n\x1B[32mNote\x1B[0m: Brainfuck exited normally.\n");
+            runtime->running = false;
+            return true;
+        case HALT_OVERFLOW:
+            dbg_runtime_error("trying to increment the data pointer out of range (%d).\n", DATA_SIZE);
+            return true;
+        case HALT_UNDERFLOW:
+            dbg_runtime_error("trying to decrement the data pointer below 0.\n");
+            return true;
+        case HALT_BREAK:
+            fprintf(stdout, "Breakpoint at instruction %d.\n", program.ir.spans[runtime->pc].start + 1);
+            return false;
+        case HALT_INTERRUPT:
+            fprintf(stdout, "\nInterrupted at instruction %d.\n", program.ir.spans[runtime->pc].start + 1);
+            return false;
+        default:
+            return false;
     }
 }
 
@@ -708,16 +5116,21 @@ bool dbg_next(int count) {
         return false;
     }
 
-    bool ret = false;
-    for (int i = 0; i < count; ++i) {
-        ret = dbg_interpret(&runtime, program.instructions[runtime.pc]);
+    return dbg_halt(&runtime, dbg_execute(count));
+}
 
-        if (ret) {
-            break; // Break out of the loop as the runtime was terminated either by OP_END or a runtime error
-        }
-    }
+int dbg_execute(unsigned long count) {
+    void (*handler)(int) = signal(SIGINT, &dbg_interrupt);
+    int halt = count == 1 ? engine->step(&runtime, &program) : engine->run_until(&runtime, &program, count);
+    signal(SIGINT, handler);
+
+    return halt;
+}
+
+void dbg_interrupt(int signal) {
+    (void) signal;
 
-    return ret;
+    runtime.stop = 1;
 }
 
 void dbg_jump(program_t *prog, int index) {
@@ -726,49 +5139,161 @@ void dbg_jump(program_t *prog, int index) {
         return;
     }
 
-    if (index < 1 || index > prog->instr_count) {
-        fprintf(stderr, "%d: Not in range of program's instructions [1..%d].\n", index, prog->instr_count);
+    if (index < 1 || index > (int) prog->code_len + 1) {
+        fprintf(stderr, "%d: Not in range of program's instructions [1..%d].\n", index, prog->code_len + 1);
+        return;
+    }
+
+    unsigned int pc = program_find(prog, index);
+
+    if (prog->ir.spans[pc].start != (unsigned int) index - 1) {
+        fprintf(stdout, "\x1B[33mWarning\x1B[0m: instruction %d was optimized, jumping to instruction %d instead.\n", index, prog->ir.spans[pc].start + 1);
+    }
+
+    engine_state_t state;
+    engine->read_state(&runtime, &state);
+    state.pc = pc;
+    engine->write_state(&runtime, &state);
+}
+
+void dbg_toggle_breakpoint(program_t *prog, int index) {
+    if (index < 1 || index > (int) prog->code_len + 1) {
+        fprintf(stderr, "%d: Not in range of program's instructions [1..%d].\n", index, prog->code_len + 1);
+        return;
+    }
+
+    for (int i = 0; i < breakpoint_count; ++i) {
+        if (breakpoints[i] == (unsigned int) index) {
+            breakpoints[i] = breakpoints[--breakpoint_count];
+            dbg_apply_breakpoints(prog);
+            fprintf(stdout, "Deleted breakpoint at instruction %d.\n", index);
+            return;
+        }
+    }
+
+    if (breakpoint_count == BREAKPOINT_COUNT) {
+        fprintf(stderr, "\x1B[31mError\x1B[0m: cannot set more than %d breakpoints.\n", BREAKPOINT_COUNT);
+        return;
+    }
+
+    breakpoints[breakpoint_count++] = index;
+    dbg_apply_breakpoints(prog);
+
+    unsigned int pc = program_find(prog, index);
+    if (prog->ir.spans[pc].start != (unsigned int) index - 1) {
+        fprintf(stdout, "\x1B[33mWarning\x1B[0m: instruction %d was optimized, breaking at instruction %d instead.\n", index, prog->ir.spans[pc].start + 1);
     } else {
-        runtime.pc = index - 1;
+        fprintf(stdout, "Breakpoint at instruction %d.\n", index);
+    }
+}
+
+void dbg_print_breakpoints() {
+    if (breakpoint_count == 0) {
+        fprintf(stdout, "No breakpoints.\n");
+        return;
+    }
+
+    fprintf(stdout, "Breakpoints:");
+    for (int i = 0; i < breakpoint_count; ++i) {
+        fprintf(stdout, " %d", breakpoints[i]);
+    }
+    fprintf(stdout, ".\n");
+}
+
+void dbg_apply_breakpoints(program_t *prog) {
+    for (unsigned int pc = 0; pc < prog->ir.count; ++pc) {
+        prog->ir.instructions[pc].flags &= ~IF_BREAK;
+    }
+
+    for (int i = 0; i < breakpoint_count; ++i) {
+        if (breakpoints[i] <= prog->code_len + 1) {
+            prog->ir.instructions[program_find(prog, breakpoints[i])].flags |= IF_BREAK;
+        }
+    }
+
+    // The threaded and the native code have the breakpoints compiled into them
+    free(prog->threaded);
+    prog->threaded = NULL;
+    jit_free(prog->jit);
+    prog->jit = NULL;
+}
+
+void dbg_print_engines() {
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engine_t); ++i) {
+        fprintf(stdout, "%c %s -- %s%s.\n", &engines[i] == engine ? '*' : ' ', engines[i].name, engines[i].desc,
+                engines[i].init(&program) ? "" : " (not available)");
+    }
+}
+
+bool dbg_set_engine(const char *const name) {
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engine_t); ++i) {
+        if (strcmp(engines[i].name, name) != 0) {
+            continue;
+        }
+
+        if (!engines[i].init(&program)) {
+            fprintf(stderr, "\x1B[31mError\x1B[0m: the %s engine is not available on this platform.\n", name);
+            return false;
+        }
+
+        // All engines keep their state in the runtime, so a running program continues where the last one stopped
+        engine = &engines[i];
+        fprintf(stdout, "Engine: %s.\n", name);
+        return true;
     }
+
+    fprintf(stderr, "%s: No such engine, use 'engine' to list them.\n", name);
+    return false;
 }
 
 void dbg_print_dataptr() {
-    fprintf(stdout, "$ptr: %d.\n", runtime.ptr);
+    engine_state_t state;
+    engine->read_state(&runtime, &state);
+
+    fprintf(stdout, "$ptr: %d.\n", state.ptr);
 }
 
 void dbg_set_dataptr(int dataptr) {
     if (dataptr_in_range(dataptr)) {
-        runtime.ptr = dataptr;
+        engine_state_t state;
+        engine->read_state(&runtime, &state);
+        state.ptr = dataptr;
+        engine->write_state(&runtime, &state);
     }
 }
 
 void dbg_print(int index) {
     if (dataptr_in_range(index)) {
-        int c = runtime.data[index];
+        engine_state_t state;
+        engine->read_state(&runtime, &state);
+
+        int c = state.data[index];
         if (isprint(c)) {
-            fprintf(stdout, "$[%d]: %d ('%c').\n", index, runtime.data[index], c);
+            fprintf(stdout, "$[%d]: %d ('%c').\n", index, c, c);
         } else {
-            fprintf(stdout, "$[%d]: %d.\n", index, runtime.data[index]);
+            fprintf(stdout, "$[%d]: %d.\n", index, c);
         }
     }
 }
 
 void dbg_print_tape() {
+    engine_state_t state;
+    engine->read_state(&runtime, &state);
+
     fputc('|', stdout);
 
     for (int dptr = -4; dptr < 5; ++dptr) {
-        int ptr = runtime.ptr + dptr;
+        int ptr = state.ptr + dptr;
 
         if (ptr < 0 || ptr >= DATA_SIZE) {
             continue;
         }
 
-        // dptr == 0 => dptr == runtime.ptr
+        // dptr == 0 => ptr == state.ptr
         if (dptr == 0) {
-            fprintf(stdout, " >>$[%d]: %d |", ptr, runtime.data[ptr]);
+            fprintf(stdout, " >>$[%d]: %d |", ptr, state.data[ptr]);
         } else {
-            fprintf(stdout, " $[%d]: %d |", ptr, runtime.data[ptr]);
+            fprintf(stdout, " $[%d]: %d |", ptr, state.data[ptr]);
         }
     }
 
@@ -776,36 +5301,19 @@ void dbg_print_tape() {
 }
 
 void dbg_print_op() {
-    fprintf(stdout, "@%d: ", runtime.pc + 1);
+    engine_state_t state;
+    engine->read_state(&runtime, &state);
 
-    switch (program.instructions[runtime.pc].operator) {
-        case OP_INC:
-            fputc('>', stdout);
-            break;
-        case OP_DEC:
-            fputc('<', stdout);
-            break;
-        case OP_ADD:
-            fputc('+', stdout);
-            break;
-        case OP_SUB:
-            fputc('-', stdout);
-            break;
-        case OP_OUT:
-            fputc('.', stdout);
-            break;
-        case OP_IN:
-            fputc(',', stdout);
-            break;
-        case OP_JMP:
-            fputc('[', stdout);
-            break;
-        case OP_RET:
-            fputc(']', stdout);
-            break;
-        case OP_END:
-            fputs("EOF", stdout);
-            break;
+    span_t span = program.ir.spans[state.pc];
+
+    fprintf(stdout, "@%d: ", span.start + 1);
+    print_span(stdout, &program, span);
+
+    // Instructions compiled from more than one brainfuck instruction also show what they do
+    if (span.end - span.start > 1) {
+        fputs(" (", stdout);
+        print_instruction(stdout, program.ir.instructions[state.pc]);
+        fputc(')', stdout);
     }
 
     fputc('\n', stdout);
@@ -813,6 +5321,231 @@ void dbg_print_op() {
 
 void dbg_set_cell(int index, unsigned short value) {
     if (dataptr_in_range(index)) {
-        runtime.data[index] = value;
+        engine_state_t state;
+        engine->read_state(&runtime, &state);
+        state.data[index] = value;
+        engine->write_state(&runtime, &state);
+    }
+}
+
+int diff_compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+bool diff_directory(const char *dir_name) {
+#ifdef POSIX
+    DIR *dir = opendir(dir_name);
+
+    if (!dir) {
+        fprintf(stderr, "%s: No such directory.\n", dir_name);
+        return false;
+    }
+
+    /// The names of the programs in the directory
+    char **names = NULL;
+    /// The count of programs
+    int count = 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+
+        if (len > 3 && strcmp(&entry->d_name[len - 3], ".bf") == 0) {
+            names = (char**) realloc(names, sizeof(char*) * (count + 1));
+            names[count++] = strdup(entry->d_name);
+        }
+    }
+
+    closedir(dir);
+
+    // Report the programs in the same order on every system
+    qsort(names, count, sizeof(char*), &diff_compare_names);
+
+    fprintf(stdout, "Comparing -O0 with -O%d on %d programs in %s...\n", opt_level, count, dir_name);
+
+    /// The count of programs with each outcome
+    int outcomes[3] = { 0 };
+
+    for (int i = 0; i < count; ++i) {
+        size_t len = strlen(dir_name) + strlen(names[i]) + 2;
+
+        char *file_name = (char*) malloc(len);
+        char *input_name = (char*) malloc(len);
+
+        snprintf(file_name, len, "%s/%s", dir_name, names[i]);
+        snprintf(input_name, len, "%s/%.*s.in", dir_name, (int) strlen(names[i]) - 3, names[i]);
+
+        fprintf(stdout, "%s: ", names[i]);
+        outcomes[diff_program(file_name, input_name)]++;
+
+        free(file_name);
+        free(input_name);
+        free(names[i]);
+    }
+
+    free(names);
+
+    fprintf(stdout, "Compared %d programs: %d same, %d diverged, %d skipped.\n", count, outcomes[DIFF_SAME], outcomes[DIFF_DIVERGED], outcomes[DIFF_SKIPPED]);
+
+    return outcomes[DIFF_DIVERGED] == 0;
+#else
+    fprintf(stderr, "\x1B[31mError\x1B[0m: %s: directories can only be listed on POSIX systems.\n", dir_name);
+    return false;
+#endif
+}
+
+int diff_program(const char *file_name, const char *input_name) {
+    /// The unoptimized and the optimized program, static because of the size of their initial tapes
+    static program_t programs[2];
+    /// The runtimes the programs run on
+    static runtime_t runtimes[2];
+
+    /// The names of the ways a program can halt
+    const char *halts[] = {
+        "running out of steps", "exiting normally", "an overflow", "an underflow", "a breakpoint", "an interrupt", "a hot loop"
+    };
+
+    int levels[2] = { 0, opt_level };
+    diff_result_t results[2] = { { .output = NULL }, { .output = NULL } };
+
+    int outcome = DIFF_SAME;
+
+    for (int i = 0; i < 2 && outcome == DIFF_SAME; ++i) {
+        if (!diff_run(file_name, input_name, levels[i], &programs[i], &runtimes[i], &results[i])) {
+            fprintf(stdout, "skipped, could not be run with -O%d.\n", levels[i]);
+            outcome = DIFF_SKIPPED;
+        } else if (results[i].halt == HALT_NONE && i == 0) {
+            fprintf(stdout, "skipped, did not finish within %d steps.\n", DIFF_STEPS);
+            outcome = DIFF_SKIPPED;
+        }
+    }
+
+    if (outcome == DIFF_SAME) {
+        rewind(results[0].output);
+        rewind(results[1].output);
+
+        // The output is compared first, as it is what the program was run for
+        long byte = 0;
+        int expected, actual;
+        while ((expected = getc(results[0].output)) == (actual = getc(results[1].output)) && expected != EOF) {
+            byte++;
+        }
+
+        /// The source index of the instruction the unoptimized program halted at
+        unsigned int index = results[0].span.start;
+
+        if (expected != actual) {
+            fprintf(stdout, "\x1B[31mdiverges\x1B[0m, output byte %ld is %d instead of %d.\n", byte, actual, expected);
+            outcome = DIFF_DIVERGED;
+        } else if (results[0].halt != results[1].halt) {
+            fprintf(stdout, "\x1B[31mdiverges\x1B[0m, halts with %s instead of %s.\n", halts[results[1].halt], halts[results[0].halt]);
+            outcome = DIFF_DIVERGED;
+        } else if (results[0].halt != HALT_END && (index < results[1].span.start || index >= results[1].span.end)) {
+            // The optimized instruction has to be compiled from the one the unoptimized program failed at
+            fprintf(stdout, "\x1B[31mdiverges\x1B[0m, fails at instruction %d (%d:%d) instead of %d (%d:%d).\n",
+                    results[1].span.start + 1, results[1].span.line, results[1].span.col,
+                    index + 1, results[0].span.line, results[0].span.col);
+            outcome = DIFF_DIVERGED;
+        } else if (results[0].halt == HALT_END) {
+            // The tapes are only comparable when both programs finished, errors leave the cells of folded instructions
+            // in between
+            int cell = 0;
+            while (cell < DATA_SIZE && runtimes[0].data[cell] == runtimes[1].data[cell]) {
+                cell++;
+            }
+
+            if (cell < DATA_SIZE) {
+                fprintf(stdout, "\x1B[31mdiverges\x1B[0m, $[%d] is %d instead of %d.\n", cell, runtimes[1].data[cell], runtimes[0].data[cell]);
+                outcome = DIFF_DIVERGED;
+            } else if (runtimes[0].ptr != runtimes[1].ptr) {
+                fprintf(stdout, "\x1B[31mdiverges\x1B[0m, $ptr is %d instead of %d.\n", runtimes[1].ptr, runtimes[0].ptr);
+                outcome = DIFF_DIVERGED;
+            }
+        }
+
+        if (outcome == DIFF_SAME && results[0].halt == HALT_END) {
+            fprintf(stdout, "same, %ld bytes of output in %lu instead of %lu steps.\n", byte, results[1].steps, results[0].steps);
+        } else if (outcome == DIFF_SAME) {
+            fprintf(stdout, "same, %s at instruction %d in %lu instead of %lu steps.\n", halts[results[0].halt], index + 1, results[1].steps, results[0].steps);
+        }
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        if (results[i].output) {
+            fclose(results[i].output);
+        }
+
+        ir_free(&programs[i].ir);
+        free(programs[i].threaded);
+        programs[i].threaded = NULL;
+        free(programs[i].code);
+        programs[i].code = NULL;
+    }
+
+    return outcome;
+}
+
+bool diff_run(const char *file_name, const char *input_name, int level, program_t *prog, runtime_t *runtime, diff_result_t *result) {
+    FILE *fp = fopen(file_name, "r");
+
+    if (!fp) {
+        return false;
+    }
+
+    // The passes run at the global optimization level
+    int saved_level = opt_level;
+    opt_level = level;
+
+    bool compiled = compile(fp, prog);
+
+    opt_level = saved_level;
+    fclose(fp);
+
+    if (!compiled) {
+        return false;
+    }
+
+    FILE *input = fopen(input_name, "rb");
+    FILE *output = tmpfile();
+
+    // Programs without an input file read empty input
+    if (!input) {
+        input = tmpfile();
+    }
+
+    if (!input || !output) {
+        fprintf(stderr, "\x1B[31mError\x1B[0m: could not create a temporary file.\n");
+
+        if (input) {
+            fclose(input);
+        }
+        if (output) {
+            fclose(output);
+        }
+
+        return false;
+    }
+
+    runtime_reset(runtime, prog);
+    runtime->input = input;
+    runtime->output = output;
+
+    result->halt = HALT_NONE;
+    result->output = runtime->output;
+
+    if (level == 0) {
+        // The reference executes one instruction at a time, like stepping through the program does
+        for (result->steps = 0; result->steps < DIFF_STEPS && result->halt == HALT_NONE; ++result->steps) {
+            result->halt = runtime_exec(runtime, prog->ir.instructions[runtime->pc]);
+        }
+    } else {
+        result->halt = runtime_run(runtime, prog, DIFF_STEPS, &result->steps);
+        result->steps += prog->prefix_steps;
     }
-}
\ No newline at end of file
+
+    result->span = prog->ir.spans[runtime->pc];
+
+    fclose(runtime->input);
+
+    return true;
+}
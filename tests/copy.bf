@@ -0,0 +1,6 @@
+Copies and moves the input byte with loops that become multiply adds
+including one with a negative factor and one that targets two cells
+
+,[->+>+<<]>>[-<<+>>]<.
+[->---<]>.
+<<[->>+<<]>>.
@@ -0,0 +1,4 @@
+Copies its input to its output until the end of the input
+which reads as 65535 so that adding one ends the loop
+
+,+[-.,+]
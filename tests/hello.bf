@@ -0,0 +1,4 @@
+Prints Hello World with nested loops that are unrolled and folded
+and that are executed ahead of time with O3
+
+++++++++[>++++[>++>+++>+++>+<<<<-]>+>+>->>+[<]<-]>>.>---.+++++++..+++.>>.<-.<.+++.------.--------.>>+.>++.
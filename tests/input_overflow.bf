@@ -0,0 +1,4 @@
+Reads a byte so that nothing is executed ahead of time and then runs
+off the right edge of the tape
+
+,[>+]
@@ -0,0 +1,3 @@
+Steps right and back in nested loops until the pointer leaves the tape
+
+>>>>>,++[[[.>><-]>>]+-<---.]-<++
@@ -0,0 +1,3 @@
+Steps left and back in a loop until the pointer leaves the tape
+
+>>>>+[<<>---]
@@ -0,0 +1,3 @@
+Adds to the cells left of the first one and takes one of the additions back in a multiply loop
+
+>+[-<<+>+<->>]
@@ -0,0 +1,3 @@
+Adds to the cell left of the first one in a loop that becomes a multiply add
+
++++[<+>-]
@@ -0,0 +1,4 @@
+Multiplies the two input bytes with a nested loop that is computed in
+closed form and prints the product and the untouched factor
+
+,>,<[>[->+>+<<]>>[-<<+>>]<<<-]>>.<.
@@ -0,0 +1,3 @@
+Runs off the right edge of the tape
+
++[>+]
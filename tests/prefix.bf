@@ -0,0 +1,5 @@
+Computes squares before reading the first input byte so that O3 executes
+all of it ahead of time and then adds the input to each of them
+
++++++++++[>+>+<<-]>[->[->+>+<<]>>[-<<+>>]<<<]>>
+,[->+>+<<]>.>.
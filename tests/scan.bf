@@ -0,0 +1,7 @@
+Scans left and right for empty cells one and two cells at a time
+
++>+>+>+>>+<<<<<
+>[>]>.
+<[<]>.
++[>>]<.
+>++++++++[<++++++++>-]<[<<]>.
@@ -0,0 +1,3 @@
+Scans left past the first cell
+
++>+>+[<]
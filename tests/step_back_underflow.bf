@@ -0,0 +1,3 @@
+Steps left of the first cell and straight back
+
+<>+.
@@ -0,0 +1,3 @@
+Moves the data pointer below the first cell after some folded moves
+
+>>><<<<
@@ -0,0 +1,5 @@
+Wraps cells around below zero and above the largest cell value
+
+-.+.
+-[--->+<]>.
+[-]+[+]+.